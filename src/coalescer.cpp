@@ -0,0 +1,113 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "coalescer.hpp"
+#include "data_format.hpp"
+#include "utility.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  coalescer::coalescer(const std::string &p) : path(p) {
+    arrived = std::time(nullptr);
+
+    std::string lock = path + ".lock";
+    fd = open(lock.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      /* coalescing is only an optimization, so evaluate the data sources
+       * independently */
+      ::fand::logger()->warn("unable to open lock file '{0}', not "
+                             "coalescing: {1}",
+                             lock, std::strerror(errno));
+      return;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      ::fand::logger()->info("waiting for a concurrent invocation to "
+                             "finish evaluating the data sources");
+
+      int rc;
+      do {
+        rc = flock(fd, LOCK_EX);
+      } while (rc != 0 and errno == EINTR);
+
+      if (rc != 0) {
+        ::fand::logger()->warn("unable to lock '{0}', not coalescing: {1}",
+                               lock, std::strerror(errno));
+        close(fd);
+        fd = -1;
+        return;
+      }
+
+      waited = true;
+    }
+  }
+
+  coalescer::~coalescer() {
+    if (fd >= 0) {
+      /* closing the descriptor releases the lock */
+      close(fd);
+    }
+  }
+
+  bool coalescer::fresh() const {
+    /* data published by an earlier invocation that finished before this
+     * one started is never reused, even within the same second */
+    if (fd < 0 or not waited) {
+      return false;
+    }
+
+    /* the modification time has a resolution of at least a second, so
+     * data published in the second this invocation started is also
+     * reused */
+    struct stat s;
+    if (stat(path.c_str(), &s) != 0) {
+      return false;
+    }
+
+    return s.st_mtime >= arrived;
+  }
+
+  std::unique_ptr<std::istream> coalescer::data() const {
+    ::fand::logger()->info("reusing the data published by a concurrent "
+                           "invocation");
+    return std::make_unique<std::ifstream>(path);
+  }
+
+  void coalescer::publish(const std::list<json> &jsonl) const {
+    if (fd < 0) {
+      return;
+    }
+
+    /* a reader that does not hold the lock never sees a partially
+     * written file */
+    if (not replace_file(path, [&](std::ostream &out) {
+          write_data(out, jsonl, data_format::JSON);
+        })) {
+      ::fand::logger()->warn("unable to publish the data to '{}'", path);
+    }
+  }
+} // namespace fand
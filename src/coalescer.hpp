@@ -0,0 +1,74 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <ctime>
+#include <istream>
+#include <list>
+#include <memory>
+#include <string>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  /*! \brief Coalesce concurrent invocations on the same node into one
+   *  evaluation of the data sources.
+   *
+   *  Each invocation takes an advisory lock, waiting for the invocation
+   *  holding it.  The invocation holding the lock either reuses the data
+   *  published while it was waiting, or evaluates the data sources itself
+   *  and publishes the data for the invocations waiting behind it.
+   */
+  class coalescer {
+  public:
+    /*! \brief Take the lock, waiting for any invocation holding it
+     *  \param[in] path Published data file.  The lock is the same path
+     *                  with a .lock suffix.
+     */
+    coalescer(const std::string &path);
+
+    /*! \brief Release the lock */
+    ~coalescer();
+
+    coalescer(const coalescer &) = delete;
+    coalescer &operator=(const coalescer &) = delete;
+
+    /*! \brief Whether data was published after this invocation started,
+     *  i.e., by an invocation that was running while this one waited.
+     *  Always false if this invocation did not wait for the lock.
+     */
+    bool fresh() const;
+
+    /*! \brief Published data, one data source per line */
+    std::unique_ptr<std::istream> data() const;
+
+    /*! \brief Publish the data for the invocations that are waiting */
+    void publish(const std::list<json> &) const;
+
+  private:
+    /*! \brief Published data file */
+    std::string path;
+
+    /*! \brief Lock file descriptor, -1 if the lock is not held */
+    int fd = -1;
+
+    /*! \brief Time this invocation started waiting for the lock */
+    std::time_t arrived;
+
+    /*! \brief Whether another invocation held the lock when this one
+     *  tried to take it */
+    bool waited = false;
+  };
+} // namespace fand
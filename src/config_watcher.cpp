@@ -0,0 +1,150 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config_watcher.hpp"
+#include "config.h"
+#include "utility.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+namespace fand {
+  config_watcher::config_watcher(const std::string &path,
+                                 std::function<void()> c)
+      : on_change(c) {
+#ifdef HAVE_SYS_INOTIFY_H
+    auto slash = path.rfind('/');
+    std::string dir = ".";
+    name = path;
+    if (slash != std::string::npos) {
+      dir = slash == 0 ? "/" : path.substr(0, slash);
+      name = path.substr(slash + 1);
+    }
+
+    /* reloading is optional, so keep serving the current configuration
+     * without it, e.g., when the inotify instances are exhausted */
+    fd = inotify_init();
+    if (fd < 0 or inotify_add_watch(fd, dir.c_str(),
+                                    IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+      ::fand::logger()->warn("unable to watch configuration file '{0}', "
+                             "changes are ignored: {1}",
+                             path, std::strerror(errno));
+      if (fd >= 0) {
+        close(fd);
+        fd = -1;
+      }
+      return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (pipe(wake) != 0) {
+      ::fand::logger()->warn("unable to create pipe, changes to the "
+                             "configuration file '{0}' are ignored: {1}",
+                             path, std::strerror(errno));
+      close(fd);
+      fd = -1;
+      return;
+    }
+    fcntl(wake[0], F_SETFD, FD_CLOEXEC);
+    fcntl(wake[1], F_SETFD, FD_CLOEXEC);
+
+    ::fand::logger()->info("watching configuration file {}", path);
+
+    thread = std::thread([this]() { run(); });
+#else
+    ::fand::logger()->warn("inotify is not available, changes to the "
+                           "configuration file '{}' are ignored",
+                           path);
+#endif
+  }
+
+  config_watcher::~config_watcher() {
+    if (thread.joinable()) {
+      /* wake up the watching thread */
+      char c = 0;
+      if (write(wake[1], &c, 1) < 0) {
+        ::fand::logger()->debug("unable to stop the watching thread");
+      }
+
+      thread.join();
+    }
+
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (wake[0] >= 0) {
+      close(wake[0]);
+      close(wake[1]);
+    }
+  }
+
+  void config_watcher::run() {
+#ifdef HAVE_SYS_INOTIFY_H
+    pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+
+    /* large enough for at least one event with the longest name */
+    alignas(inotify_event) char buf[4096];
+
+    while (true) {
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ::fand::logger()->error("error watching the configuration file: {}",
+                                std::strerror(errno));
+        return;
+      }
+
+      if (fds[1].revents != 0) {
+        /* stopping */
+        return;
+      }
+
+      if (not(fds[0].revents & POLLIN)) {
+        continue;
+      }
+
+      ssize_t n = read(fd, buf, sizeof(buf));
+      if (n <= 0) {
+        continue;
+      }
+
+      /* several events may be read at once, e.g., when the file is saved
+       * twice in quick succession.  report them once. */
+      bool changed = false;
+      for (char *p = buf; p < buf + n;) {
+        auto e = reinterpret_cast<inotify_event *>(p);
+        if (e->len > 0 and name == e->name) {
+          changed = true;
+        }
+        p += sizeof(inotify_event) + e->len;
+      }
+
+      if (changed) {
+        ::fand::logger()->debug("configuration file {} changed", name);
+        on_change();
+      }
+    }
+#endif
+  }
+} // namespace fand
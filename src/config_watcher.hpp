@@ -0,0 +1,65 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace fand {
+  /*! \brief Watch a configuration file for changes with inotify.
+   *
+   *  The directory containing the file is watched rather than the file
+   *  itself, so a file that is replaced, e.g., by an editor that writes a
+   *  new file and renames it, is still followed.  Only complete writes are
+   *  reported.  Where inotify is not available, or the file cannot be
+   *  watched, a warning is logged and changes are not reported.
+   */
+  class config_watcher {
+  public:
+    /*! \brief Start watching
+     *  \param[in] path Configuration file
+     *  \param[in] on_change Called on the watching thread each time the
+     *                       file has been written or replaced
+     */
+    config_watcher(const std::string &path, std::function<void()> on_change);
+
+    /*! \brief Stop watching */
+    ~config_watcher();
+
+    config_watcher(const config_watcher &) = delete;
+    config_watcher &operator=(const config_watcher &) = delete;
+
+  private:
+    /*! \brief Wait for changes until stopped */
+    void run();
+
+    /*! \brief Name of the file within the watched directory */
+    std::string name;
+
+    /*! \brief inotify instance */
+    int fd = -1;
+
+    /*! \brief Self pipe used to stop the watching thread */
+    int wake[2] = {-1, -1};
+
+    /*! \brief Function to call when the file changes */
+    std::function<void()> on_change;
+
+    /*! \brief Watching thread */
+    std::thread thread;
+  };
+} // namespace fand
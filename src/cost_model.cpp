@@ -0,0 +1,88 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cost_model.hpp"
+#include "utility.hpp"
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  double cost_model::cost(const std::string &name) const {
+    auto it = costs.find(name);
+    return it != costs.end() ? it->second : 0.0;
+  }
+
+  void cost_model::load(const std::string &file) {
+    if (file.empty()) {
+      return;
+    }
+
+    std::ifstream in(file);
+    if (not in) {
+      ::fand::logger()->debug("no data source cost state file '{}'", file);
+      return;
+    }
+
+    try {
+      json j = json::parse(in);
+      json saved = j.value("costs", json::object());
+      for (auto const &c : saved.items()) {
+        costs[c.key()] = c.value().get<double>();
+      }
+      ::fand::logger()->debug("loaded {0} data source costs from '{1}'",
+                              costs.size(), file);
+    }
+    catch (std::exception &e) {
+      /* the state file is only a scheduling hint, so ignore it if it is
+       * corrupt */
+      ::fand::logger()->warn("ignoring data source cost state file '{0}': "
+                             "'{1}'",
+                             file, e.what());
+      costs.clear();
+    }
+  }
+
+  void cost_model::record(const std::string &name,
+                          std::chrono::duration<double> elapsed) {
+    auto it = costs.find(name);
+
+    if (it == costs.end()) {
+      costs[name] = elapsed.count();
+    }
+    else {
+      /* exponential moving average smooths out run to run noise */
+      it->second = alpha * elapsed.count() + (1 - alpha) * it->second;
+    }
+  }
+
+  void cost_model::save(const std::string &file) const {
+    if (file.empty()) {
+      return;
+    }
+
+    json j = {{"costs", costs}};
+
+    if (not replace_file(file, [&](std::ostream &out) {
+          out << j.dump() << std::endl;
+        })) {
+      ::fand::logger()->info("unable to write data source cost state "
+                             "file '{}'",
+                             file);
+    }
+  }
+} // namespace fand
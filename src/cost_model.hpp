@@ -0,0 +1,61 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  /*! \brief Historical cost model of data source evaluation times.
+   *
+   *  The wall time of each data source evaluation is recorded and
+   *  persisted in a small state file so that subsequent runs can
+   *  schedule the most expensive data sources first.
+   */
+  class cost_model {
+  public:
+    /*! \brief Load the costs from the state file.  A missing state file
+     *  is not an error.
+     */
+    void load(const std::string &);
+
+    /*! \brief Save the costs to the state file */
+    void save(const std::string &) const;
+
+    /*! \brief Record an observed evaluation time for a data source */
+    void record(const std::string &, std::chrono::duration<double>);
+
+    /*! \brief Whether the cost of a data source is known */
+    bool known(const std::string &name) const {
+      return costs.find(name) != costs.end();
+    }
+
+    /*! \brief Expected evaluation time of a data source
+     *  \return expected time in seconds, or 0 if unknown
+     */
+    double cost(const std::string &) const;
+
+  private:
+    /*! \brief Weight of the most recent observation in the moving
+     *  average */
+    static constexpr double alpha = 0.5;
+
+    /*! \brief Expected evaluation time in seconds, by data source name */
+    std::map<std::string, double> costs;
+  };
+} // namespace fand
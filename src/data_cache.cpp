@@ -0,0 +1,96 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "data_cache.hpp"
+#include "utility.hpp"
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  namespace {
+    /* seconds since the epoch */
+    double seconds(std::chrono::system_clock::time_point t) {
+      return std::chrono::duration<double>(t.time_since_epoch()).count();
+    }
+  } // namespace
+
+  json data_cache::load(const std::string &name,
+                        std::chrono::seconds max_age,
+                        std::chrono::duration<double> &age) const {
+    std::ifstream in(path(name));
+    if (not in) {
+      ::fand::logger()->debug("no cached data for {}", name);
+      return static_cast<json>(nullptr);
+    }
+
+    try {
+      json j = json::parse(in);
+
+      age = std::chrono::duration<double>(
+          seconds(std::chrono::system_clock::now()) -
+          j.at("timestamp").get<double>());
+      if (age > max_age) {
+        ::fand::logger()->debug("cached data for {0} is stale, {1} s old",
+                                name, age.count());
+        return static_cast<json>(nullptr);
+      }
+
+      return j.at("data");
+    }
+    catch (std::exception &e) {
+      /* the cache is only an optimization, so ignore a corrupt record */
+      ::fand::logger()->warn("ignoring cached data for {0}: '{1}'", name,
+                             e.what());
+      return static_cast<json>(nullptr);
+    }
+  }
+
+  std::string data_cache::path(const std::string &name) const {
+    /* the record is named after the data source, which must not escape
+     * the cache directory */
+    std::string file = name;
+    for (auto &c : file) {
+      if (c == '/') {
+        c = '_';
+      }
+    }
+
+    return dir + "/" + file + ".json";
+  }
+
+  void
+  data_cache::store(const std::string &name, const json &data,
+                    std::chrono::system_clock::time_point evaluated) const {
+    if (mkdir(dir.c_str(), 0755) != 0 and errno != EEXIST) {
+      ::fand::logger()->info("unable to create cache directory '{}'", dir);
+      return;
+    }
+
+    json j = {{"timestamp", seconds(evaluated)}, {"data", data}};
+
+    if (not replace_file(path(name), [&](std::ostream &out) {
+          out << j.dump(-1, ' ', false, json::error_handler_t::replace)
+              << std::endl;
+        })) {
+      ::fand::logger()->info("unable to write cached data for {}", name);
+    }
+  }
+} // namespace fand
@@ -0,0 +1,62 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  /*! \brief Node local cache of data source evaluations.
+   *
+   *  Each data source has its own record in the cache directory holding
+   *  the evaluated data and the time it was evaluated, so a subsequent
+   *  run can reuse the data that is still fresh enough rather than
+   *  evaluating the data source again.
+   */
+  class data_cache {
+  public:
+    /*! \brief construct a data cache
+     *  \param[in] dir Cache directory.  Created when the first record is
+     *                 stored.
+     */
+    explicit data_cache(const std::string &d) : dir(d){};
+
+    /*! \brief Load the record of a data source.  A missing, corrupt, or
+     *  stale record is not an error.
+     *  \param[in] name Data source name
+     *  \param[in] max_age Maximum age of the record
+     *  \param[out] age Age of the record
+     *  \return evaluated data, or null if there is no fresh record
+     */
+    json load(const std::string &name, std::chrono::seconds max_age,
+              std::chrono::duration<double> &age) const;
+
+    /*! \brief Store the record of a data source
+     *  \param[in] name Data source name
+     *  \param[in] evaluated Time the data source was evaluated
+     */
+    void store(const std::string &name, const json &,
+               std::chrono::system_clock::time_point evaluated) const;
+
+  private:
+    /*! \brief Path of the record of a data source */
+    std::string path(const std::string &name) const;
+
+    /*! \brief Cache directory */
+    std::string dir;
+  };
+} // namespace fand
@@ -0,0 +1,308 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "data_format.hpp"
+#include "utility.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  namespace {
+    /* the first byte is not valid in a JSON text, so the header cannot
+     * be mistaken for newline delimited JSON */
+    const std::string magic("\x89"
+                            "FAND\r\n\x1a",
+                            8);
+
+    /* identifies the format, following the magic header */
+    enum : uint8_t { CBOR = 1, MSGPACK = 2 };
+
+    /* 32-bit little endian record length */
+    std::string length(uint32_t n) {
+      return {static_cast<char>(n & 0xff), static_cast<char>((n >> 8) & 0xff),
+              static_cast<char>((n >> 16) & 0xff),
+              static_cast<char>((n >> 24) & 0xff)};
+    }
+
+    /* chunks of a mapped file are at least this large */
+    constexpr size_t min_chunk = 1 << 20;
+
+    void check_format(int format) {
+      if (format != CBOR and format != MSGPACK) {
+        throw std::runtime_error("unknown data format " +
+                                 std::to_string(format));
+      }
+
+      ::fand::logger()->debug("reading {} data",
+                              format == CBOR ? "CBOR" : "MessagePack");
+    }
+
+    json parse_record(int format, const uint8_t *p, size_t n) {
+      return format == CBOR ? json::from_cbor(p, p + n)
+                            : json::from_msgpack(p, p + n);
+    }
+
+    bool read_length(std::istream &is, uint32_t &n) {
+      unsigned char b[4];
+      if (not is.read(reinterpret_cast<char *>(b), sizeof(b))) {
+        if (is.gcount() != 0) {
+          throw std::runtime_error("truncated record length");
+        }
+        return false;
+      }
+
+      n = static_cast<uint32_t>(b[0]) | static_cast<uint32_t>(b[1]) << 8 |
+          static_cast<uint32_t>(b[2]) << 16 |
+          static_cast<uint32_t>(b[3]) << 24;
+      return true;
+    }
+  } // namespace
+
+  data_writer::data_writer(std::ostream &os, data_format f)
+      : format(f), out(os) {
+    if (format == data_format::JSON) {
+      return;
+    }
+
+    out << magic;
+    out.put(static_cast<char>(format == data_format::CBOR ? CBOR : MSGPACK));
+    out.flush();
+  }
+
+  void data_writer::write(const json &j) {
+    std::string record;
+
+    if (format == data_format::JSON) {
+      record = j.dump(-1, ' ', false, json::error_handler_t::replace);
+      record += '\n';
+    }
+    else {
+      auto b = format == data_format::CBOR ? json::to_cbor(j)
+                                           : json::to_msgpack(j);
+      record = length(static_cast<uint32_t>(b.size()));
+      record.append(b.begin(), b.end());
+    }
+
+    std::lock_guard<std::mutex> lock(m);
+    out.write(record.data(), record.size());
+    out.flush();
+  }
+
+  void write_data(std::ostream &os, const std::list<json> &jsonl,
+                  data_format format) {
+    data_writer w(os, format);
+    for (auto const &j : jsonl) {
+      w.write(j);
+    }
+  }
+
+  std::list<json> read_data(std::istream &is) {
+    std::list<json> jsonl;
+
+    /* the first byte of the magic header is never the first byte of
+     * newline delimited JSON.  peek rather than read ahead so that
+     * streams that cannot seek, e.g., pipes, can be read. */
+    if (is.peek() != static_cast<unsigned char>(magic[0])) {
+      for (std::string s; std::getline(is, s);) {
+        jsonl.push_back(json::parse(s));
+      }
+      return jsonl;
+    }
+
+    std::string header(magic.size(), '\0');
+    is.read(&header[0], header.size());
+    if (header != magic) {
+      throw std::runtime_error("unknown data format");
+    }
+
+    int format = is.get();
+    check_format(format);
+
+    uint32_t n;
+    std::vector<uint8_t> record;
+    while (read_length(is, n)) {
+      record.resize(n);
+      if (not is.read(reinterpret_cast<char *>(record.data()), n)) {
+        throw std::runtime_error("truncated record");
+      }
+
+      jsonl.push_back(parse_record(format, record.data(), n));
+    }
+
+    return jsonl;
+  }
+
+  std::list<json> read_data(const std::string &file, thread_pool &pool) {
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat s;
+    if (fd < 0 or fstat(fd, &s) != 0 or not S_ISREG(s.st_mode) or
+        s.st_size == 0) {
+      /* pipes, terminals, and empty files cannot be mapped */
+      if (fd >= 0) {
+        close(fd);
+      }
+
+      ::fand::logger()->debug("reading '{}' as a stream", file);
+      std::ifstream in(file, std::ios::binary);
+      if (not in) {
+        throw std::runtime_error("unable to open '" + file + "'");
+      }
+      return read_data(in);
+    }
+
+    size_t size = static_cast<size_t>(s.st_size);
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      ::fand::logger()->debug("unable to map '{0}', reading it as a stream: "
+                              "{1}",
+                              file, std::strerror(errno));
+      std::ifstream in(file, std::ios::binary);
+      return read_data(in);
+    }
+
+    /* unmap however the parsing ends */
+    std::unique_ptr<void, std::function<void(void *)>> mapping(
+        addr, [size](void *a) { munmap(a, size); });
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(addr);
+    const char *end = data + size;
+
+    /* each chunk is a contiguous range of lines or records, parsed on its
+     * own thread.  the chunks are concatenated in order, so the result is
+     * the same as parsing the file sequentially. */
+    struct chunk_t {
+      const char *begin;
+      const char *end;
+      std::vector<json> values;
+      std::exception_ptr error;
+    };
+    std::vector<chunk_t> chunks;
+
+    /* small files are not worth splitting */
+    size_t target = std::max(size / (pool.size() * 4), min_chunk);
+
+    int format = 0;
+    if (size > magic.size() and std::string(data, magic.size()) == magic) {
+      format = static_cast<unsigned char>(data[magic.size()]);
+      check_format(format);
+
+      /* the record boundaries are only known by walking the length
+       * prefixes, which is cheap compared to parsing the records */
+      const char *p = data + magic.size() + 1;
+      const char *begin = p;
+      while (p < end) {
+        if (end - p < 4) {
+          throw std::runtime_error("truncated record length");
+        }
+
+        auto b = reinterpret_cast<const unsigned char *>(p);
+        uint32_t n = static_cast<uint32_t>(b[0]) |
+                     static_cast<uint32_t>(b[1]) << 8 |
+                     static_cast<uint32_t>(b[2]) << 16 |
+                     static_cast<uint32_t>(b[3]) << 24;
+        if (static_cast<size_t>(end - p - 4) < n) {
+          throw std::runtime_error("truncated record");
+        }
+
+        p += 4 + n;
+        if (static_cast<size_t>(p - begin) >= target or p == end) {
+          chunks.push_back({begin, p, {}, nullptr});
+          begin = p;
+        }
+      }
+    }
+    else {
+      /* split at newline boundaries */
+      const char *begin = data;
+      while (begin < end) {
+        const char *p = begin + std::min(target, size_t(end - begin));
+        if (p < end) {
+          p = static_cast<const char *>(std::memchr(p, '\n', end - p));
+          p = p ? p + 1 : end;
+        }
+
+        chunks.push_back({begin, p, {}, nullptr});
+        begin = p;
+      }
+    }
+
+    ::fand::logger()->debug("parsing '{0}' in {1} chunks", file,
+                            chunks.size());
+
+    for (auto &c : chunks) {
+      pool.submit([&c, format]() {
+        try {
+          if (format == 0) {
+            for (const char *p = c.begin; p < c.end;) {
+              auto nl = static_cast<const char *>(
+                  std::memchr(p, '\n', c.end - p));
+              const char *eol = nl ? nl : c.end;
+              c.values.push_back(json::parse(p, eol));
+              p = eol + 1;
+            }
+          }
+          else {
+            for (const char *p = c.begin; p < c.end;) {
+              auto b = reinterpret_cast<const unsigned char *>(p);
+              uint32_t n = static_cast<uint32_t>(b[0]) |
+                           static_cast<uint32_t>(b[1]) << 8 |
+                           static_cast<uint32_t>(b[2]) << 16 |
+                           static_cast<uint32_t>(b[3]) << 24;
+              c.values.push_back(parse_record(format, b + 4, n));
+              p += 4 + n;
+            }
+          }
+        }
+        catch (...) {
+          c.error = std::current_exception();
+        }
+      });
+    }
+
+    pool.wait();
+
+    std::list<json> jsonl;
+    for (auto &c : chunks) {
+      if (c.error) {
+        std::rethrow_exception(c.error);
+      }
+
+      std::move(c.values.begin(), c.values.end(), std::back_inserter(jsonl));
+    }
+
+    return jsonl;
+  }
+} // namespace fand
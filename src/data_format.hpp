@@ -0,0 +1,92 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "thread_pool.hpp"
+#include <istream>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  /*! \brief Formats of collected data files */
+  enum class data_format { JSON, CBOR, MSGPACK };
+
+  /*! \brief Thread safe writer of collected data and of the streamed
+   *  check events.
+   *
+   *  JSON is newline delimited, one value per line.  The binary formats
+   *  start with a magic header followed by the format, and each value is
+   *  a record prefixed by its length as a 32-bit little endian integer.
+   *
+   *  Each value is serialized before taking the lock and then written
+   *  with a single write followed by a flush, so records from concurrent
+   *  writers never interleave and each is visible to the reader as soon
+   *  as it is written.  Records are deliberately not held back in one
+   *  large buffer until the end: the records already written survive if
+   *  the process is killed, e.g., by a scheduler time limit.  The cost is
+   *  one flush per value, which is small next to collecting the data.
+   */
+  class data_writer {
+  public:
+    /*! \brief construct a writer, writing the header of the format
+     *  \param[in] os Output stream, must outlive the writer
+     *  \param[in] format Output format
+     */
+    data_writer(std::ostream &os, data_format format);
+
+    /*! \brief Write the data of a data source */
+    void write(const json &);
+
+  private:
+    /*! \brief Output format */
+    data_format format;
+
+    /*! \brief Serializes writes to the output stream */
+    std::mutex m;
+
+    /*! \brief Output stream */
+    std::ostream &out;
+  };
+
+  /*! \brief Write collected data with a data_writer
+   *  \param[in] os Output stream
+   *  \param[in] jsonl Collected data, one value per data source
+   *  \param[in] format Output format
+   */
+  void write_data(std::ostream &os, const std::list<json> &jsonl,
+                  data_format format);
+
+  /*! \brief Read collected data written by write_data().  The format is
+   *  detected from the magic header.
+   *  \throws std::runtime_error if a binary record is truncated
+   */
+  std::list<json> read_data(std::istream &);
+
+  /*! \brief Read a file of collected data written by write_data().  The
+   *  file is mapped into memory, split into chunks at line or record
+   *  boundaries, and the chunks are parsed in parallel.  A file that
+   *  cannot be mapped, e.g., a pipe, is read as a stream.
+   *  \param[in] file Path of the file
+   *  \param[in] pool Thread pool to parse the chunks on.  Must not be
+   *                  running any other tasks.
+   *  \return the values in the order they appear in the file
+   *  \throws std::runtime_error if a binary record is truncated
+   */
+  std::list<json> read_data(const std::string &file, thread_pool &pool);
+} // namespace fand
@@ -0,0 +1,658 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "executor.hpp"
+#include "utility.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  namespace {
+    /* result for a check that could not be performed */
+    std::shared_ptr<wassail::result> maybe_result(const check_pair &cp,
+                                                  const std::string &detail) {
+      auto r = wassail::make_result();
+      r->brief = cp.check->name();
+      r->detail = detail;
+      r->issue = wassail::result::issue_t::MAYBE;
+      return r;
+    }
+  } // namespace
+
+  void executor::build(const std::list<check_pair> &pairs,
+                       bool prerequisites) {
+    sources.clear();
+    checks.clear();
+
+    /* build the data source -> check pairs graph */
+    std::map<std::shared_ptr<wassail::data::common>, size_t> index;
+    std::map<std::string, std::vector<size_t>> ids;
+
+    for (auto const &cp : pairs) {
+      auto it = index.find(cp.data);
+      if (it == index.end()) {
+        it = index.emplace(cp.data, sources.size()).first;
+        sources.emplace_back();
+        sources.back().data = cp.data;
+      }
+
+      auto &n = sources[it->second];
+      n.dependents.push_back(checks.size());
+
+      n.resource = std::max(n.resource, cp.resource);
+      n.weight += cp.weight;
+      n.cost = std::max(n.cost, cp.cost);
+
+      /* if the dependent check pairs specify different timeouts, use the
+       * shortest one */
+      if (cp.timeout.count() > 0 and
+          (n.timeout.count() == 0 or cp.timeout < n.timeout)) {
+        n.timeout = cp.timeout;
+      }
+
+      ids[cp.id].push_back(checks.size());
+      checks.push_back({&cp, it->second, {}, 0, check_node::state_t::WAITING});
+    }
+
+    /* prefer the measured cost, falling back to the configured cost if
+     * the data source has not been measured.  data that is already
+     * collected costs nothing, whatever its measured cost. */
+    for (auto &n : sources) {
+      if (collected and collected(n.data)) {
+        n.cost = 0;
+        continue;
+      }
+
+      double measured = cost ? cost(n.data) : 0;
+      if (measured > 0) {
+        n.cost = measured;
+      }
+    }
+
+    if (not prerequisites) {
+      return;
+    }
+
+    /* build the check pair -> check pairs that require it graph.  a
+     * prerequisite may match several check pairs, e.g., one per
+     * filesystem, in which case all of them must pass. */
+    for (size_t i = 0; i < checks.size(); i++) {
+      for (auto const &p : checks[i].cp->prerequisites) {
+        auto it = ids.find(p);
+        if (it == ids.end()) {
+          ::fand::logger()->debug("ignoring prerequisite {0} of check {1}, "
+                                  "no such check",
+                                  p, checks[i].cp->id);
+          continue;
+        }
+
+        for (auto j : it->second) {
+          if (j != i) {
+            checks[j].dependents.push_back(i);
+            checks[i].pending++;
+          }
+        }
+      }
+    }
+  }
+
+  bool executor::can_dispatch(const source_node &n) const {
+    /* nothing starts while an exclusive data source is running */
+    if (running_by_class.at(resource_class::EXCLUSIVE) > 0) {
+      return false;
+    }
+
+    switch (n.resource) {
+    case resource_class::EXCLUSIVE:
+      /* wait until everything else has completed */
+      return running == 0 and
+             std::all_of(ready.cbegin(), ready.cend(),
+                         [](const source_node *r) {
+                           return r->resource == resource_class::EXCLUSIVE;
+                         });
+    case resource_class::IO:
+    case resource_class::MEMORY_BANDWIDTH:
+      return running_by_class.at(n.resource) == 0;
+    default:
+      return true;
+    }
+  }
+
+  void executor::cancel() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+
+      {
+        std::lock_guard<std::mutex> clock(cancellation->m);
+        if (cancellation->cancelled) {
+          return;
+        }
+        cancellation->cancelled = true;
+      }
+      /* wake up any worker waiting for an in-flight evaluation */
+      cancellation->cv.notify_all();
+
+      ::fand::logger()->info("failing fast, cancelling {} data sources",
+                             ready.size());
+
+      /* data sources that have not been started never will be */
+      auto cancelled = ready;
+      ready.clear();
+      for (auto n : cancelled) {
+        skip(*n, "skipped: fail fast");
+      }
+    }
+
+    report();
+  }
+
+  void executor::complete(size_t i, std::shared_ptr<wassail::result> r) {
+    auto &c = checks[i];
+
+    if (c.state == check_node::state_t::DONE) {
+      return;
+    }
+
+    c.state = check_node::state_t::DONE;
+    results[i] = r;
+
+    /* reported once the lock is released, so a slow completion function
+     * does not hold up the other workers */
+    unreported.emplace_back(i, r);
+
+    bool passed = r and r->issue == wassail::result::issue_t::NO;
+
+    for (auto d : c.dependents) {
+      if (checks[d].state == check_node::state_t::DONE) {
+        continue;
+      }
+
+      if (not passed) {
+        ::fand::logger()->info("skipping check {0}, prerequisite {1} failed",
+                               checks[d].cp->id, c.cp->id);
+        complete(d, maybe_result(*checks[d].cp,
+                                 "skipped: prerequisite failed"));
+      }
+      else if (--checks[d].pending == 0) {
+        runnable(d);
+      }
+    }
+  }
+
+  void executor::dispatch() {
+    std::lock_guard<std::mutex> lock(m);
+
+    /* ready is emptied when cancelled, so nothing new is started */
+    while (running < pool.size()) {
+      /* first ready data source, in LPT order, that may start now */
+      auto it = std::find_if(
+          ready.begin(), ready.end(),
+          [this](const source_node *r) { return can_dispatch(*r); });
+      if (it == ready.end()) {
+        break;
+      }
+
+      source_node *n = *it;
+      ready.erase(it);
+      n->state = source_node::state_t::RUNNING;
+      running++;
+      running_by_class[n->resource]++;
+
+      ::fand::logger()->debug("dispatching data source {0} (expected {1} s)",
+                              n->data->name(), n->cost);
+      pool.submit([this, n]() { run_node(*n); });
+    }
+  }
+
+  std::shared_ptr<const json> executor::evaluate_node(source_node &n) {
+    if (n.timeout.count() <= 0 and not fail_fast) {
+      return std::make_shared<const json>(evaluate(n.data));
+    }
+
+    /* evaluate on a separate thread so that the evaluation can be
+     * abandoned.  there is no way to interrupt a blocked evaluation, so
+     * the thread is detached.  everything it touches is reference counted
+     * so it remains valid until the evaluation eventually completes, even
+     * if the executor is gone. */
+    struct state_t {
+      json value;
+      std::exception_ptr error;
+      bool done = false;
+    };
+    auto state = std::make_shared<state_t>();
+
+    /* unlike done, read without the lock after the run, to find out
+     * whether an abandoned evaluation has since completed */
+    auto finished = std::make_shared<std::atomic<bool>>(false);
+    auto c = cancellation;
+
+    {
+      /* the run may have been cancelled after this data source was
+       * dispatched */
+      std::lock_guard<std::mutex> lock(c->m);
+      if (c->cancelled) {
+        n.reason = "skipped: fail fast";
+        return nullptr;
+      }
+    }
+
+    std::thread([e = evaluate, d = n.data, state, finished, c]() {
+      json value;
+      std::exception_ptr error;
+
+      try {
+        value = e(d);
+      }
+      catch (...) {
+        error = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(c->m);
+        state->value = std::move(value);
+        state->error = error;
+        state->done = true;
+      }
+      *finished = true;
+      c->cv.notify_all();
+    }).detach();
+
+    std::unique_lock<std::mutex> lock(c->m);
+    auto ready = [&]() { return state->done or c->cancelled; };
+
+    if (n.timeout.count() > 0) {
+      c->cv.wait_for(lock, n.timeout, ready);
+    }
+    else {
+      c->cv.wait(lock, ready);
+    }
+
+    if (not state->done) {
+      n.abandoned = true;
+      n.finished = finished;
+
+      if (c->cancelled) {
+        n.reason = "abandoned: fail fast";
+      }
+      else {
+        ::fand::logger()->error("data source {0} timed out after {1} ms",
+                                n.data->name(), n.timeout.count());
+        n.timed_out = true;
+        n.reason = "data source " + n.data->name() + " timed out after " +
+                   std::to_string(n.timeout.count()) + " ms";
+      }
+
+      return nullptr;
+    }
+
+    if (state->error) {
+      std::rethrow_exception(state->error);
+    }
+
+    return std::make_shared<const json>(std::move(state->value));
+  }
+
+  void executor::finish(size_t i, std::shared_ptr<wassail::result> r) {
+    if (checks[i].dependents.empty()) {
+      /* the slot is written by this task only, and nothing requires this
+       * check, so there is no need to lock */
+      results[i] = r;
+      notify(i, r);
+    }
+    else {
+      {
+        std::lock_guard<std::mutex> lock(m);
+        complete(i, r);
+      }
+
+      report();
+
+      /* checks that required this one may need their data sources */
+      dispatch();
+    }
+
+    /* priorities are ordered from most to least severe */
+    if (fail_fast and r and r->issue == wassail::result::issue_t::YES and
+        r->priority <= fail_fast_priority) {
+      cancel();
+    }
+  }
+
+  double executor::makespan(const std::vector<source_node *> &selected) const {
+    /* exclusive data sources run alone, one after the other.  the others
+     * share the workers, but cannot finish before the longest one. */
+    double exclusive = 0;
+    double longest = 0;
+    double total = 0;
+
+    for (auto n : selected) {
+      if (n->resource == resource_class::EXCLUSIVE) {
+        exclusive += n->cost;
+      }
+      else {
+        longest = std::max(longest, n->cost);
+        total += n->cost;
+      }
+    }
+
+    return exclusive + std::max(longest, total / pool.size());
+  }
+
+  void executor::notify(size_t i, std::shared_ptr<wassail::result> r) {
+    if (completion) {
+      completion(*checks[i].cp, r,
+                 std::chrono::steady_clock::now() - run_start);
+    }
+  }
+
+  void executor::report() {
+    std::vector<std::pair<size_t, std::shared_ptr<wassail::result>>> pending;
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+      pending.swap(unreported);
+    }
+
+    for (auto const &p : pending) {
+      notify(p.first, p.second);
+    }
+  }
+
+  void executor::request(source_node &n) {
+    if (n.state != source_node::state_t::IDLE) {
+      return;
+    }
+
+    /* cancelled is only set while holding the lock, so it is safe to
+     * read here */
+    if (cancellation->cancelled) {
+      skip(n, "skipped: fail fast");
+      return;
+    }
+
+    /* longest processing time first.  data sources with equal cost keep
+     * the order they were requested. */
+    n.state = source_node::state_t::READY;
+    ready.insert(std::upper_bound(ready.begin(), ready.end(), &n,
+                                  [](const source_node *a,
+                                     const source_node *b) {
+                                    return a->cost > b->cost;
+                                  }),
+                 &n);
+  }
+
+  void executor::run_node(source_node &n) {
+    auto start = std::chrono::steady_clock::now();
+    auto data = evaluate_node(n);
+    n.elapsed = std::chrono::steady_clock::now() - start;
+
+    /* before the dependent checks, so the data is reported as early as
+     * possible */
+    if (data and data_completion) {
+      data_completion(n.data, *data);
+    }
+
+    std::vector<size_t> performable;
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+      running--;
+      running_by_class[n.resource]--;
+
+      n.state = source_node::state_t::DONE;
+      n.evaluated = data != nullptr;
+
+      /* when only collecting data, no check needs the data once it has
+       * been reported, so it is not kept until the end of the run */
+      if (check) {
+        n.value = data;
+      }
+
+      for (auto c : n.dependents) {
+        if (checks[c].state != check_node::state_t::RUNNABLE) {
+          /* still waiting for prerequisites, or already skipped */
+          continue;
+        }
+
+        if (data and not check) {
+          complete(c, nullptr);
+        }
+        else if (data) {
+          checks[c].state = check_node::state_t::SUBMITTED;
+          performable.push_back(c);
+        }
+        else {
+          complete(c, maybe_result(*checks[c].cp, n.reason));
+        }
+      }
+    }
+
+    report();
+
+    /* the evaluated data is shared by the dependent checks rather than
+     * copied */
+    for (auto c : performable) {
+      submit(c);
+    }
+
+    /* the data source is done, so let the next one start */
+    dispatch();
+  }
+
+  void executor::runnable(size_t i) {
+    auto &c = checks[i];
+    auto &n = sources[c.source];
+
+    if (n.state != source_node::state_t::DONE) {
+      c.state = check_node::state_t::RUNNABLE;
+      request(n);
+    }
+    else if (n.evaluated and not check) {
+      complete(i, nullptr);
+    }
+    else if (n.value) {
+      c.state = check_node::state_t::SUBMITTED;
+      submit(i);
+    }
+    else {
+      complete(i, maybe_result(*c.cp, n.reason));
+    }
+  }
+
+  void executor::select() {
+    /* greedily pick the data sources with the most check weight per
+     * second of expected evaluation time, as long as the estimated wall
+     * time still fits the budget */
+    std::vector<source_node *> candidates;
+    for (auto &n : sources) {
+      /* data sources that were already skipped are not candidates */
+      if (n.state == source_node::state_t::IDLE) {
+        candidates.push_back(&n);
+      }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const source_node *a, const source_node *b) {
+                       /* a * b > b * a avoids dividing by a zero cost */
+                       return a->weight * b->cost > b->weight * a->cost;
+                     });
+
+    std::vector<source_node *> selected;
+    for (auto n : candidates) {
+      selected.push_back(n);
+
+      if (makespan(selected) > budget) {
+        selected.pop_back();
+        skip(*n, "skipped: budget");
+      }
+    }
+
+    ::fand::logger()->debug("selected {0} of {1} data sources, estimated "
+                            "{2} s for a budget of {3} s",
+                            selected.size(), sources.size(),
+                            makespan(selected), budget);
+  }
+
+  void executor::skip(source_node &n, const std::string &reason) {
+    ::fand::logger()->info("data source {0} {1}", n.data->name(), reason);
+
+    n.state = source_node::state_t::DONE;
+    n.reason = reason;
+
+    for (auto c : n.dependents) {
+      complete(c, maybe_result(*checks[c].cp, reason));
+    }
+  }
+
+  void executor::submit(size_t i) {
+    pool.submit([this, i]() {
+      auto const &c = checks[i];
+      finish(i, check(*c.cp, *sources[c.source].value));
+    });
+  }
+
+  std::vector<std::shared_ptr<wassail::result>>
+  executor::execute(const std::list<check_pair> &pairs, check_fn f,
+                    bool prerequisites) {
+    run_start = std::chrono::steady_clock::now();
+    build(pairs, prerequisites);
+
+    ::fand::logger()->debug("{0} distinct data sources for {1} check pairs",
+                            sources.size(), checks.size());
+
+    /* one result slot per check pair.  each slot is written by exactly
+     * one task. */
+    check = f;
+    results.assign(checks.size(), nullptr);
+
+    ready.clear();
+    unreported.clear();
+    cancellation = std::make_shared<cancellation_t>();
+    running = 0;
+    running_by_class = {{resource_class::CHEAP, 0},
+                        {resource_class::IO, 0},
+                        {resource_class::MEMORY_BANDWIDTH, 0},
+                        {resource_class::EXCLUSIVE, 0}};
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+
+      /* checks in a prerequisite cycle can never be performed.  find them
+       * by topologically sorting the checks. */
+      std::vector<size_t> pending(checks.size());
+      std::deque<size_t> order;
+      std::vector<bool> acyclic(checks.size(), false);
+
+      for (size_t i = 0; i < checks.size(); i++) {
+        pending[i] = checks[i].pending;
+        if (pending[i] == 0) {
+          order.push_back(i);
+        }
+      }
+
+      while (not order.empty()) {
+        auto i = order.front();
+        order.pop_front();
+        acyclic[i] = true;
+
+        for (auto d : checks[i].dependents) {
+          if (--pending[d] == 0) {
+            order.push_back(d);
+          }
+        }
+      }
+
+      for (size_t i = 0; i < checks.size(); i++) {
+        if (not acyclic[i]) {
+          ::fand::logger()->error("check {} depends on a prerequisite cycle",
+                                  checks[i].cp->id);
+          complete(i, maybe_result(*checks[i].cp,
+                                   "skipped: prerequisite cycle"));
+        }
+      }
+
+      if (deferred) {
+        for (auto &n : sources) {
+          if (deferred(n.data)) {
+            skip(n, "skipped: not evaluated yet");
+          }
+        }
+      }
+
+      if (budget > 0) {
+        select();
+      }
+
+      /* checks without prerequisites may be performed right away.  their
+       * data sources are evaluated on demand, so a data source whose
+       * checks are all skipped is never evaluated. */
+      for (size_t i = 0; i < checks.size(); i++) {
+        if (checks[i].state == check_node::state_t::WAITING and
+            checks[i].pending == 0) {
+          runnable(i);
+        }
+      }
+    }
+
+    report();
+
+    /* evaluate each distinct data source exactly once.  when it is ready,
+     * submit its dependent checks. */
+    dispatch();
+
+    /* wait for all the data sources and checks to complete */
+    pool.wait();
+
+    _abandoned.clear();
+    _timings.clear();
+    for (auto const &n : sources) {
+      if (n.abandoned) {
+        _abandoned.push_back({n.data, n.finished});
+      }
+
+      if (n.timed_out) {
+        _timings.emplace_back(n.data, n.timeout);
+      }
+      else if (n.evaluated) {
+        _timings.emplace_back(n.data, n.elapsed);
+      }
+    }
+
+    return std::move(results);
+  }
+
+  std::vector<std::shared_ptr<wassail::result>>
+  executor::run(const std::list<check_pair> &pairs, check_fn f) {
+    return execute(pairs, f, true);
+  }
+
+  void executor::run(const std::list<check_pair> &pairs) {
+    /* only collecting data, so there are no check results to satisfy the
+     * prerequisites */
+    execute(pairs, nullptr, false);
+  }
+} // namespace fand
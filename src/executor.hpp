@@ -0,0 +1,394 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "fand.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  /*! \brief Dependency aware executor for check pairs.
+   *
+   *  Several check pairs may share the same data source.  The executor
+   *  builds a data source -> check pairs graph so that each distinct
+   *  data source is evaluated exactly once, and each dependent check is
+   *  started as soon as its data source is ready.  The data sources and
+   *  checks are run on a thread pool.
+   *
+   *  Check pairs may also require other check pairs.  A check pair is
+   *  only performed once all of its prerequisites have passed, and a data
+   *  source is only evaluated once at least one of its dependent check
+   *  pairs may be performed.  If a prerequisite does not pass, the
+   *  dependent check pair is skipped and its data source is not
+   *  evaluated on its behalf.
+   *
+   *  Each check writes its result into a preallocated slot indexed by
+   *  the position of the check pair, so no synchronization is needed
+   *  while the checks run and the results are always returned in check
+   *  pair order regardless of the number of threads.
+   *
+   *  A data source with a timeout is evaluated on a separate thread.  If
+   *  it does not complete before the deadline, it is abandoned and each
+   *  dependent check yields a MAYBE result rather than blocking the
+   *  remaining checks.
+   *
+   *  Data sources are dispatched longest expected evaluation time first
+   *  (LPT) so the total wall time approaches that of the most expensive
+   *  data source.
+   *
+   *  Dispatching also honors the resource class of each data source.  An
+   *  EXCLUSIVE data source, such as a benchmark, is only started once all
+   *  other data sources have completed and runs alone, so its
+   *  measurement is not perturbed.  At most one IO and one
+   *  MEMORY_BANDWIDTH data source run at a time, and CHEAP data sources
+   *  are packed around them.
+   *
+   *  Given a wall time budget, the executor selects the subset of data
+   *  sources whose dependent checks are most valuable, by check pair
+   *  weight, and whose estimated wall time fits the budget.  The
+   *  dependents of the remaining data sources are reported as skipped.
+   *
+   *  In fail fast mode, the first check that finds an issue at or above
+   *  a given priority cancels the run.  No new data sources are started
+   *  and in-flight evaluations are abandoned.
+   *
+   *  An optional completion function is called as each check completes,
+   *  whether it was performed or skipped, so results can be reported
+   *  before the run finishes.  Likewise, an optional data completion
+   *  function is called as each data source is evaluated.  Both may be
+   *  called concurrently from several threads.
+   */
+  class executor {
+  public:
+    /*! \brief Function to evaluate a data source */
+    using evaluate_fn =
+        std::function<json(std::shared_ptr<wassail::data::common>)>;
+
+    /*! \brief Function to perform a check on the evaluated data */
+    using check_fn = std::function<std::shared_ptr<wassail::result>(
+        const check_pair &, const json &)>;
+
+    /*! \brief Function returning the expected evaluation time of a data
+     *  source, in seconds */
+    using cost_fn =
+        std::function<double(std::shared_ptr<wassail::data::common>)>;
+
+    /*! \brief Function returning whether a data source is in a set, e.g.,
+     *  whether its data is already collected, so evaluating it costs
+     *  nothing */
+    using collected_fn =
+        std::function<bool(std::shared_ptr<wassail::data::common>)>;
+
+    /*! \brief Function called when a check completes with its result,
+     *  which may be null, and the time since the start of the run */
+    using completion_fn =
+        std::function<void(const check_pair &, std::shared_ptr<wassail::result>,
+                           std::chrono::duration<double>)>;
+
+    /*! \brief Function called when a data source has been evaluated
+     *  with its data */
+    using data_fn = std::function<void(std::shared_ptr<wassail::data::common>,
+                                       const json &)>;
+
+    /*! \brief Data source and the wall time of its evaluation */
+    using timing_t = std::pair<std::shared_ptr<wassail::data::common>,
+                               std::chrono::duration<double>>;
+
+    /*! \brief construct an executor */
+    executor(thread_pool &p, evaluate_fn e, cost_fn c = nullptr)
+        : pool(p), evaluate(e), cost(c){};
+
+    /*! \brief Limit the estimated wall time of a run.  Data sources
+     *  that do not fit are skipped.
+     *  \param[in] seconds Wall time budget.  If 0, there is no budget.
+     */
+    void set_budget(double seconds) { budget = seconds; }
+
+    /*! \brief Cancel the run when a check finds an issue
+     *  \param[in] priority Only issues at or above this priority cancel
+     *                      the run
+     */
+    void set_fail_fast(wassail::result::priority_t priority) {
+      fail_fast = true;
+      fail_fast_priority = priority;
+    }
+
+    /*! \brief Data sources whose data is already collected, e.g.,
+     *  loaded from a file or cached, do not count against the budget
+     */
+    void set_collected(collected_fn f) { collected = f; }
+
+    /*! \brief Skip the data sources that should not be evaluated in this
+     *  run, along with the checks that depend on them
+     */
+    void set_deferred(collected_fn f) { deferred = f; }
+
+    /*! \brief Report each check as it completes */
+    void set_completion(completion_fn f) { completion = f; }
+
+    /*! \brief Report each data source as soon as it has been evaluated.
+     *  Abandoned data sources are not reported.
+     */
+    void set_data_completion(data_fn f) { data_completion = f; }
+
+    /*! \brief Whether the last run was cancelled by fail fast mode */
+    bool cancelled() const {
+      return cancellation and cancellation->cancelled;
+    }
+
+    /*! \brief Evaluate the data sources and perform the checks
+     *  \return check results, in the same order as the check pairs.  The
+     *  result is null if the check did not produce one.
+     */
+    std::vector<std::shared_ptr<wassail::result>>
+    run(const std::list<check_pair> &, check_fn);
+
+    /*! \brief Evaluate the data sources only */
+    void run(const std::list<check_pair> &);
+
+    /*! \brief A data source whose evaluation was abandoned */
+    struct abandoned_t {
+      std::shared_ptr<wassail::data::common> data; /*!< data source */
+      std::shared_ptr<const std::atomic<bool>>
+          finished; /*!< set once the abandoned evaluation has completed */
+    };
+
+    /*! \brief Data sources that were abandoned because they timed out or
+     *  the run was cancelled.  The evaluation of these data sources may
+     *  still be in progress.
+     */
+    const std::vector<abandoned_t> &abandoned() const { return _abandoned; }
+
+    /*! \brief Evaluation wall time of each data source during the last
+     *  run.  Abandoned data sources are reported with their timeout.
+     */
+    const std::vector<timing_t> &timings() const { return _timings; }
+
+  private:
+    /*! \brief Cancellation state shared with the evaluation threads */
+    struct cancellation_t {
+      std::mutex m; /*!< protects cancelled and the evaluation state */
+      std::condition_variable cv; /*!< signaled when an evaluation completes
+                                     or the run is cancelled */
+      bool cancelled = false;     /*!< run was cancelled */
+    };
+
+    /*! \brief A distinct data source and the check pairs that depend on it
+     */
+    struct source_node {
+      /*! \brief Data source states */
+      enum class state_t { IDLE, READY, RUNNING, DONE };
+
+      std::shared_ptr<wassail::data::common> data; /*!< data source */
+      std::vector<size_t> dependents; /*!< indices of the dependent checks */
+      std::chrono::milliseconds timeout{0}; /*!< 0 means no timeout */
+      double cost = 0;        /*!< expected evaluation time in seconds */
+      double weight = 0; /*!< total weight of the dependent check pairs */
+      resource_class resource =
+          resource_class::CHEAP; /*!< most restrictive resource class of the
+                                    dependent check pairs */
+      state_t state = state_t::IDLE; /*!< evaluation state */
+      std::shared_ptr<const json> value; /*!< evaluated data, null if the
+                                            data source was skipped or
+                                            abandoned, or if only collecting
+                                            data */
+      bool evaluated = false; /*!< data source was evaluated */
+      bool abandoned = false; /*!< evaluation was abandoned */
+      std::shared_ptr<const std::atomic<bool>>
+          finished; /*!< set once an abandoned evaluation completes */
+      bool timed_out = false; /*!< evaluation was abandoned due to timeout */
+      std::string reason; /*!< reason the data source was skipped or
+                             abandoned, empty if it was evaluated */
+      std::chrono::duration<double> elapsed{0}; /*!< evaluation time */
+    };
+
+    /*! \brief A check pair and the check pairs that require it */
+    struct check_node {
+      /*! \brief Check states */
+      enum class state_t { WAITING, RUNNABLE, SUBMITTED, DONE };
+
+      const check_pair *cp; /*!< check pair */
+      size_t source;        /*!< index of the data source */
+      std::vector<size_t> dependents; /*!< indices of the checks that
+                                         require this check */
+      size_t pending = 0; /*!< number of unresolved prerequisites */
+      state_t state = state_t::WAITING; /*!< check state */
+    };
+
+    /*! \brief Build the data source and check pair graphs
+     *  \param[in] prerequisites Whether to honor the check pair
+     *                           prerequisites
+     */
+    void build(const std::list<check_pair> &, bool prerequisites);
+
+    /*! \brief Whether the resource class of a ready data source allows it
+     *  to start now.  The caller must hold the lock.
+     */
+    bool can_dispatch(const source_node &) const;
+
+    /*! \brief Cancel the run.  Skip the data sources that have not
+     *  started and abandon the in-flight evaluations.
+     */
+    void cancel();
+
+    /*! \brief Record the result of a check and resolve the checks that
+     *  require it.  The check is reported by the next report().  The
+     *  caller must hold the lock.
+     */
+    void complete(size_t, std::shared_ptr<wassail::result>);
+
+    /*! \brief Submit ready data sources to the thread pool, up to the
+     *  number of workers, subject to their resource classes */
+    void dispatch();
+
+    /*! \brief Evaluate the data source of the node, honoring its timeout
+     *  \return evaluated data, or null if the evaluation was abandoned
+     */
+    std::shared_ptr<const json> evaluate_node(source_node &);
+
+    /*! \brief Evaluate the data sources and perform the checks
+     *  \param[in] prerequisites Whether to honor the check pair
+     *                           prerequisites
+     */
+    std::vector<std::shared_ptr<wassail::result>>
+    execute(const std::list<check_pair> &, check_fn, bool prerequisites);
+
+    /*! \brief Record the result of a performed check */
+    void finish(size_t, std::shared_ptr<wassail::result>);
+
+    /*! \brief Estimated wall time to evaluate a set of data sources */
+    double makespan(const std::vector<source_node *> &) const;
+
+    /*! \brief Report a completed check, if requested */
+    void notify(size_t, std::shared_ptr<wassail::result>);
+
+    /*! \brief Report the completed checks that have not been reported
+     *  yet.  The caller must not hold the lock.
+     */
+    void report();
+
+    /*! \brief Queue a data source for evaluation, if it is not already.
+     *  The caller must hold the lock.
+     */
+    void request(source_node &);
+
+    /*! \brief Evaluate a data source and perform its runnable checks */
+    void run_node(source_node &);
+
+    /*! \brief A check whose prerequisites have all passed may be
+     *  performed once its data source is evaluated.  The caller must hold
+     *  the lock.
+     */
+    void runnable(size_t);
+
+    /*! \brief Skip the data sources that do not fit the budget */
+    void select();
+
+    /*! \brief Skip a data source and all of its pending checks.  The
+     *  caller must hold the lock.
+     */
+    void skip(source_node &, const std::string &);
+
+    /*! \brief Submit a check to the thread pool */
+    void submit(size_t);
+
+    /*! \brief Thread pool to run the data sources and checks */
+    thread_pool &pool;
+
+    /*! \brief Function used to evaluate each data source */
+    evaluate_fn evaluate;
+
+    /*! \brief Function used to estimate the cost of each data source */
+    cost_fn cost;
+
+    /*! \brief Function used to find the data already collected */
+    collected_fn collected;
+
+    /*! \brief Function used to find the data sources to skip */
+    collected_fn deferred;
+
+    /*! \brief Wall time budget in seconds, 0 is no budget */
+    double budget = 0;
+
+    /*! \brief Cancel the run when a check finds an issue */
+    bool fail_fast = false;
+
+    /*! \brief Minimum priority of an issue that cancels the run */
+    wassail::result::priority_t fail_fast_priority =
+        wassail::result::priority_t::DEBUG;
+
+    /*! \brief Cancellation state of the current run */
+    std::shared_ptr<cancellation_t> cancellation;
+
+    /*! \brief Function called as each check completes */
+    completion_fn completion;
+
+    /*! \brief Function called as each data source is evaluated */
+    data_fn data_completion;
+
+    /*! \brief Start time of the current run */
+    std::chrono::steady_clock::time_point run_start;
+
+    /*! \brief Function used to perform each check during a run, null if
+     *  only collecting data */
+    check_fn check;
+
+    /*! \brief Data sources of the current run */
+    std::vector<source_node> sources;
+
+    /*! \brief Check pairs of the current run */
+    std::vector<check_node> checks;
+
+    /*! \brief Protects the data source and check states, ready, running,
+     *  running_by_class, and unreported */
+    std::mutex m;
+
+    /*! \brief Data sources waiting to be dispatched, in dispatch order */
+    std::deque<source_node *> ready;
+
+    /*! \brief Number of data sources being evaluated */
+    size_t running = 0;
+
+    /*! \brief Number of data sources being evaluated, by resource class */
+    std::map<resource_class, size_t> running_by_class;
+
+    /*! \brief Checks completed while holding the lock that have not been
+     *  reported yet, with their results */
+    std::vector<std::pair<size_t, std::shared_ptr<wassail::result>>>
+        unreported;
+
+    /*! \brief Check results of the current run */
+    std::vector<std::shared_ptr<wassail::result>> results;
+
+    /*! \brief Data sources abandoned during the last run */
+    std::vector<abandoned_t> _abandoned;
+
+    /*! \brief Evaluation wall times during the last run */
+    std::vector<timing_t> _timings;
+  };
+} // namespace fand
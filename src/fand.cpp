@@ -15,10 +15,15 @@
 
 #include "fand.hpp"
 #include "config.h"
+#include "data_cache.hpp"
+#include "data_format.hpp"
+#include "executor.hpp"
+#include "low_impact.hpp"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 #include "utility.hpp"
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <functional>
 #include <future>
@@ -27,16 +32,32 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 #include <wassail/wassail.hpp>
 
-#if defined(HAVE_EXECUTION_H) && __cpp_lib_execution >= 201603L
-#include <execution>
-#endif
-
 namespace fand {
-  fand::fand(system_t s, wassail::log_level log_level) {
+  resource_class default_resource(category c) {
+    switch (c) {
+    case category::FILESYSTEM:
+    case category::NETWORK:
+      return resource_class::IO;
+    case category::PERFORMANCE:
+      /* benchmarks are perturbed by anything running concurrently */
+      return resource_class::EXCLUSIVE;
+    default:
+      return resource_class::CHEAP;
+    }
+  }
+
+  fand::fand(system_t s, wassail::log_level log_level, unsigned int jobs,
+             bool low_impact, const std::string &cpus) {
     _system = s;
 
     /* initialize the system dispatch table.  each system type needs a
@@ -53,6 +74,17 @@ namespace fand {
     logger->set_level(static_cast<spdlog::level::level_enum>(log_level));
 
     logger->debug("wassail version {}", wassail::version());
+
+    /* before starting any threads so they all inherit the CPU list */
+    if (not cpus.empty() and not pin_threads(cpus)) {
+      exit(1);
+    }
+
+    /* start the worker threads.  the threads used to evaluate data
+     * sources with a timeout are started by the workers, so they inherit
+     * the lower priorities. */
+    pool = std::make_unique<thread_pool>(
+        jobs, low_impact ? lower_thread_priority : std::function<void()>());
   }
 
   void fand::add_check_pair(check_pair cp, std::shared_ptr<wassail::result> r) {
@@ -62,50 +94,68 @@ namespace fand {
     checks.push_back(cp);
   }
 
-  void fand::check() {
+  void fand::check(executor::completion_fn on_complete) {
     ::fand::logger()->debug("invoking check subcommand for {} pairs",
                             checks.size());
 
-    std::for_each(
-#if __cpp_lib_execution >= 201603L
-        std::execution::par,
-#endif
-        checks.cbegin(), checks.cend(), [&](const auto &cp) {
-          ::fand::logger()->info("performing check {}", cp.check->name());
-
-          /* get the data from the data source */
-          json d = get_data(cp.data);
-
-          try {
-            /* perform the check on the data and store the result */
-            auto r = cp.check->check(d);
-            cp.result->add_child(r);
-            ::fand::logger()->trace(static_cast<json>(r).dump());
-          }
-          catch (std::exception &e) {
-            ::fand::logger()->error("error performing check {0}: '{1}'",
-                                    cp.check->name(), e.what());
-          }
-        });
+    auto results = perform(checks, on_complete);
+
+    /* store the results in check pair order so the result tree is the same
+     * regardless of the order the checks completed */
+    auto r = results.cbegin();
+    for (auto const &cp : checks) {
+      if (*r) {
+        cp.result->add_child(*r);
+      }
+      r++;
+    }
   }
 
-  std::list<json> fand::collect() {
+  void fand::collect(std::function<void(const json &)> on_data) {
     ::fand::logger()->debug("invoking collect subcommand for {} pairs",
                             checks.size());
 
-    /* collect the data */
-    std::for_each(
-#if __cpp_lib_execution >= 201603L
-        std::execution::par,
-#endif
-        checks.cbegin(), checks.cend(),
-        [&](const auto &cp) { get_data(cp.data); });
+    /* the same data may be reported by distinct data sources.  the data
+     * should only be included once.  compute a hash and skip duplicates. */
+    std::mutex m;
+    std::set<size_t> seen;
+
+    /* collect the data, evaluating each distinct data source once, and
+     * hand out the data of each data source as soon as it is ready */
+    execute(checks, nullptr, nullptr,
+            [&](std::shared_ptr<wassail::data::common> d, const json &j) {
+              if (j.is_null()) {
+                /* not enabled or the evaluation failed */
+                return;
+              }
+
+              {
+                std::lock_guard<std::mutex> lock(m);
+                if (not seen.insert(std::hash<json>{}(j)).second) {
+                  return;
+                }
+              }
+
+              on_data(j);
+            });
+  }
 
+  std::list<json> fand::collected() const {
     /* create a list of data in json format */
     std::list<json> jsonl;
     std::map<size_t, bool> seen;
 
     for (auto const &cp : checks) {
+      /* an abandoned data source may still be evaluating, so it is not
+       * safe to access */
+      if (abandoned_sources.count(cp.data) > 0) {
+        continue;
+      }
+
+      if (not cp.data->collected()) {
+        continue;
+      }
+
       json j = cp.data->to_json();
 
       /* the same data source may be used in multiple check pairs.  the data
@@ -122,25 +172,160 @@ namespace fand {
     return jsonl;
   }
 
+  std::vector<std::shared_ptr<wassail::result>>
+  fand::execute(const std::list<check_pair> &pairs, executor::check_fn f,
+                executor::completion_fn on_complete,
+                executor::data_fn on_data) {
+    /* an abandoned evaluation that has since completed no longer touches
+     * its data source, so evaluate it again */
+    for (auto it = abandoned_sources.begin(); it != abandoned_sources.end();) {
+      if (*it->second) {
+        ::fand::logger()->info("abandoned evaluation of data source {} has "
+                               "completed",
+                               it->first->name());
+        it = abandoned_sources.erase(it);
+      }
+      else {
+        it++;
+      }
+    }
+
+    /* data sources that were already collected, e.g., loaded from a file
+     * or still fresh in the cache, are not evaluated so their timings say
+     * nothing about their cost */
+    std::set<std::shared_ptr<wassail::data::common>> precollected;
+    for (auto const &cp : pairs) {
+      /* an abandoned data source may still be evaluating, so it is not
+       * safe to access */
+      if (abandoned_sources.count(cp.data) > 0) {
+        continue;
+      }
+
+      if ((cp.data->collected() and not reevaluate) or fresh(cp.data)) {
+        precollected.insert(cp.data);
+      }
+    }
+
+    executor exec(
+        *pool, [&](auto d) { return get_data(d); },
+        [&](auto d) { return costs.cost(d->name()); });
+
+    exec.set_collected([&](auto d) { return precollected.count(d) > 0; });
+
+    /* when trickling, a data source without data waits for its slot */
+    if (trickle_source) {
+      exec.set_deferred([&](auto d) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return d != trickle_source and not cache[d].valid;
+      });
+    }
+    exec.set_completion(on_complete);
+    exec.set_data_completion(on_data);
+
+    if (options) {
+      exec.set_budget(options->budget);
+
+      if (options->fail_fast) {
+        exec.set_fail_fast(options->fail_fast_priority);
+      }
+    }
+
+    /* without a check function, only collect the data */
+    std::vector<std::shared_ptr<wassail::result>> results;
+    if (f) {
+      results = exec.run(pairs, f);
+    }
+    else {
+      exec.run(pairs);
+    }
+
+    if (exec.cancelled()) {
+      ::fand::logger()->warn("stopped at the first check with an issue");
+    }
+
+    for (auto const &a : exec.abandoned()) {
+      abandoned_sources[a.data] = a.finished;
+    }
+
+    durations.clear();
+    for (auto const &t : exec.timings()) {
+      if (precollected.count(t.first) == 0) {
+        durations[t.first->name()] = t.second.count();
+        ::fand::logger()->debug("data source {0} took {1} s",
+                                t.first->name(), t.second.count());
+        costs.record(t.first->name(), t.second);
+      }
+    }
+
+    return results;
+  }
+
+  bool fand::fresh(std::shared_ptr<wassail::data::common> d) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = cache.find(d);
+    if (it == cache.end() or not it->second.valid) {
+      return false;
+    }
+
+    /* when trickling, only the data source due in the current slot is
+     * evaluated */
+    if (reuse_cached and d != trickle_source) {
+      return true;
+    }
+
+    return std::chrono::steady_clock::now() - it->second.evaluated <
+           it->second.ttl;
+  }
+
   json fand::get_data(std::shared_ptr<wassail::data::common> d) {
+    /* a previous evaluation may still be running, so the data source is
+     * not safe to access at all */
+    if (abandoned_sources.count(d) > 0) {
+      ::fand::logger()->warn("data source {} was abandoned, not evaluating "
+                             "it again",
+                             d->name());
+      return static_cast<json>(nullptr);
+    }
+
     /* verify that the data source is enabled, i.e., valid, for this system */
     if (d->enabled()) {
       /* wassail caches data source evaluations.  if the data has already been
        * collected, just return it. */
-      if (d->collected()) {
+      if (d->collected() and not reevaluate) {
         ::fand::logger()->info("data source {} has already been collected",
                                d->name());
         return d->to_json();
       }
+      else if (reevaluate and fresh(d)) {
+        ::fand::logger()->info("data source {} is still fresh", d->name());
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return cache[d].value;
+      }
       else {
         try {
           ::fand::logger()->info("evaluating data source {0}", d->name());
 
-          d->evaluate();
+          d->evaluate(reevaluate);
 
           json j = d->to_json();
           ::fand::logger()->trace(j.dump());
 
+          {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            auto &e = cache[d];
+            e.evaluated = std::chrono::steady_clock::now();
+            e.valid = true;
+
+            /* the cached data is only read back when checking
+             * periodically, so a single run does not hold another copy
+             * of every payload */
+            if (serving or e.ttl.count() > 0) {
+              e.value = j;
+            }
+          }
+
           return j;
         }
         catch (std::exception &e) {
@@ -160,43 +345,545 @@ namespace fand {
     ::fand::logger()->debug("invoking list subcommand");
 
     std::cout << std::left << std::setw(30) << "Check"
-              << "  " << std::left << std::setw(30) << "Data" << std::endl;
+              << "  " << std::left << std::setw(30) << "Data"
+              << "  " << std::left << std::setw(10) << "Cost" << std::endl;
     std::cout << std::setw(30) << std::setfill('-') << "-"
-              << "  " << std::setw(30) << std::setfill('-') << "-" << std::endl;
+              << "  " << std::setw(30) << std::setfill('-') << "-"
+              << "  " << std::setw(10) << std::setfill('-') << "-"
+              << std::endl;
     std::cout << std::setfill(' ');
 
-    std::for_each(checks.cbegin(), checks.cend(), [](const auto &cp) {
+    std::for_each(checks.cbegin(), checks.cend(), [&](const auto &cp) {
+      /* learned data source cost, if any */
+      std::stringstream cost;
+      if (costs.known(cp.data->name())) {
+        cost << std::setprecision(3) << costs.cost(cp.data->name()) << " s";
+      }
+      else {
+        cost << "-";
+      }
+
       std::cout << std::left << std::setw(30) << cp.check->name() << "  "
-                << std::left << std::setw(30) << cp.data->name() << std::endl;
+                << std::left << std::setw(30) << cp.data->name() << "  "
+                << std::left << std::setw(10) << cost.str() << std::endl;
     });
   }
 
+  bool fand::has_abandoned() const {
+    for (auto const &a : abandoned_sources) {
+      if (not *a.second) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void fand::load_cache(const std::string &dir, unsigned int max_age) {
+    if (dir.empty() or max_age == 0) {
+      return;
+    }
+
+    data_cache c(dir);
+    std::set<std::shared_ptr<wassail::data::common>> seen;
+
+    for (auto const &cp : checks) {
+      if (cp.data->collected() or not seen.insert(cp.data).second) {
+        continue;
+      }
+
+      std::chrono::duration<double> age;
+      json j = c.load(cp.data->name(), std::chrono::seconds(max_age), age);
+      if (not j.is_null()) {
+        cp.data->from_json(j);
+        ::fand::logger()->info("loaded cached data for {0}, {1} s old",
+                               cp.data->name(), age.count());
+      }
+    }
+  }
+
+  void fand::load_costs(const std::string &file) { costs.load(file); }
+
   void fand::load_data(std::unique_ptr<std::istream> in) {
     ::fand::logger()->debug("loading data");
 
-    for (std::string s; std::getline((*in), s);) {
-      json j = json::parse(s);
+    /* the format is detected from the data */
+    load_records(read_data(*in));
+  }
+
+  void fand::load_data(const std::string &file) {
+    ::fand::logger()->debug("loading data from '{}'", file);
+
+    /* the format is detected from the data */
+    load_records(read_data(file, *pool));
+  }
+
+  void fand::load_records(const std::list<json> &records) {
+    /* index the distinct data sources by name once, so loading is linear
+     * in the size of the input.  several data sources may have the same
+     * name. */
+    std::unordered_multimap<std::string,
+                            std::shared_ptr<wassail::data::common>>
+        index;
+    std::set<std::shared_ptr<wassail::data::common>> seen;
+    for (auto const &cp : checks) {
+      if (seen.insert(cp.data).second) {
+        index.emplace(cp.data->name(), cp.data);
+      }
+    }
+
+    /* data sources loaded from this input, as opposed to collected
+     * before */
+    std::set<std::shared_ptr<wassail::data::common>> loaded;
+
+    for (auto const &j : records) {
       ::fand::logger()->trace("read {}", j.dump());
 
-      for (auto const &cp : checks) {
-        if (cp.data->collected()) {
+      auto range = index.equal_range(j.value("name", "unknown"));
+      for (auto it = range.first; it != range.second; it++) {
+        auto &d = it->second;
+
+        if (loaded.count(d) > 0) {
+          /* the input contains the data source more than once */
+          if (options and options->duplicates == duplicate_policy::ERROR) {
+            throw std::runtime_error("duplicate data for " + d->name());
+          }
+          else if (not options or
+                   options->duplicates == duplicate_policy::FIRST) {
+            continue;
+          }
+        }
+        else if (d->collected()) {
           continue;
         }
 
-        if (j.value("name", "unknown") == cp.data->name()) {
-          cp.data->from_json(j);
-          ::fand::logger()->info("loaded data for {}", cp.data->name());
+        d->from_json(j);
+        loaded.insert(d);
+        ::fand::logger()->info("loaded data for {}", d->name());
+      }
+    }
+  }
+
+  std::vector<std::shared_ptr<wassail::result>>
+  fand::perform(const std::list<check_pair> &pairs,
+                executor::completion_fn on_complete) {
+    auto perform_check = [&](const check_pair &cp, const json &d)
+        -> std::shared_ptr<wassail::result> {
+      ::fand::logger()->info("performing check {}", cp.check->name());
+
+      try {
+        /* perform the check on the data */
+        auto r = cp.check->check(d);
+        ::fand::logger()->trace(static_cast<json>(r).dump());
+        return r;
+      }
+      catch (std::exception &e) {
+        ::fand::logger()->error("error performing check {0}: '{1}'",
+                                cp.check->name(), e.what());
+        return nullptr;
+      }
+    };
+
+    /* evaluate each distinct data source once and perform each check as
+     * soon as its data source is ready */
+    return execute(pairs, perform_check, on_complete);
+  }
+
+  void fand::publish(std::vector<std::shared_ptr<wassail::result>> results,
+                     const std::map<std::string, double> &durations,
+                     std::function<void(const check_report &)> on_update) {
+    /* build a new result tree each time so the latest result can be
+     * handed out while the next check is being performed */
+    check_report report;
+    report.results = results;
+    report.completed = std::chrono::system_clock::now();
+    report.durations = durations;
+
+    for (auto const &cp : checks) {
+      report.ids.push_back(cp.id);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      for (auto const &e : cache) {
+        if (e.second.valid) {
+          report.data[e.first->name()] = e.second.value;
+        }
+      }
+    }
+
+    auto r = wassail::make_result();
+    r->brief = overall->brief;
+
+    for (auto const &c : report.results) {
+      if (c) {
+        r->add_child(c);
+      }
+    }
+
+    r->priority = r->max_priority();
+    r->issue = r->max_issue();
+    report.overall = r;
+
+    if (on_update) {
+      on_update(report);
+    }
+  }
+
+  void fand::reload() {
+    {
+      std::lock_guard<std::mutex> lock(serve_mutex);
+      reload_requested = true;
+    }
+    serve_cv.notify_all();
+  }
+
+  bool fand::reload_check_pairs() {
+    ::fand::logger()->info("reloading the configuration");
+
+    std::vector<check_pair> cps;
+    try {
+      cps = system_dispatch_table[_system](options);
+    }
+    catch (std::exception &e) {
+      ::fand::logger()->error("error reloading the configuration, keeping "
+                              "the previous checks: '{}'",
+                              e.what());
+      return false;
+    }
+
+    /* the systems create the data sources without any parameters, so a
+     * data source with the same name is unchanged */
+    std::map<std::string, std::shared_ptr<wassail::data::common>> current;
+    for (auto const &cp : checks) {
+      current.emplace(cp.data->name(), cp.data);
+    }
+
+    size_t reused = 0;
+    std::set<std::shared_ptr<wassail::data::common>> seen;
+    for (auto &cp : cps) {
+      auto d = current.find(cp.data->name());
+      if (d != current.end()) {
+        cp.data = d->second;
+      }
+
+      if (seen.insert(cp.data).second and d != current.end()) {
+        reused++;
+      }
+    }
+
+    ::fand::logger()->info("reloaded {0} check pairs, reusing {1} of {2} "
+                           "data sources",
+                           cps.size(), reused, seen.size());
+
+    set_check_pairs(cps);
+    return true;
+  }
+
+  void fand::save_cache(const std::string &dir) const {
+    if (dir.empty()) {
+      return;
+    }
+
+    data_cache c(dir);
+    std::set<std::shared_ptr<wassail::data::common>> seen;
+
+    /* the evaluation times are measured on the steady clock, while the
+     * records hold the wall clock time */
+    auto now = std::chrono::steady_clock::now();
+    auto wall = std::chrono::system_clock::now();
+
+    for (auto const &cp : checks) {
+      if (not seen.insert(cp.data).second) {
+        continue;
+      }
+
+      /* only the data sources evaluated by the last run, so the cached
+       * data keeps the time it was actually evaluated */
+      if (durations.count(cp.data->name()) == 0 or
+          abandoned_sources.count(cp.data) > 0 or
+          not cp.data->collected()) {
+        continue;
+      }
+
+      std::chrono::steady_clock::time_point evaluated;
+      {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto e = cache.find(cp.data);
+        if (e == cache.end() or not e->second.valid) {
           continue;
         }
+        evaluated = e->second.evaluated;
+      }
+
+      /* a data source evaluated early in a long run is older than the
+       * run */
+      auto age =
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              now - evaluated);
+      c.store(cp.data->name(), cp.data->to_json(), wall - age);
+    }
+  }
+
+  void fand::save_costs(const std::string &file) const { costs.save(file); }
+
+  void fand::serve(std::function<void(const check_report &)> on_update) {
+    serving = true;
+
+    if (options->trickle) {
+      trickle(on_update);
+      return;
+    }
+
+    ::fand::logger()->debug("invoking serve subcommand for {0} pairs every "
+                            "{1} s",
+                            checks.size(), options->interval);
+
+    auto interval = std::chrono::seconds(options->interval);
+    auto next = std::chrono::steady_clock::now();
+    bool reloaded = false;
+
+    /* the per host offset is the phase of the periodic checks */
+    if (options->splay > 0) {
+      auto offset = splay_offset(options->splay);
+      ::fand::logger()->info("delaying the first check by {} ms",
+                             offset.count());
+      if (wait(next + offset) == wake_t::STOPPING) {
+        return;
+      }
+    }
+
+    while (true) {
+      auto start = std::chrono::steady_clock::now();
+
+      /* a check right after a reload only evaluates the new data sources
+       * and does not move the schedule of the periodic checks */
+      reuse_cached = reloaded;
+      if (not reloaded) {
+        next = start + interval;
+      }
+
+      publish(perform(checks, nullptr), durations, on_update);
+
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      ::fand::logger()->info("check completed in {} s", elapsed.count());
+
+      save_costs(options->state_file);
+
+      /* the data sources were collected by the first check, so they need
+       * to be forced to evaluate again */
+      reevaluate = true;
+
+      auto w = wait(next);
+      if (w == wake_t::STOPPING) {
+        return;
+      }
+      reloaded = w == wake_t::RELOADED;
+    }
+  }
+
+  void fand::stop() {
+    {
+      std::lock_guard<std::mutex> lock(serve_mutex);
+      stopping = true;
+    }
+    serve_cv.notify_all();
+  }
+
+  void fand::trickle(std::function<void(const check_report &)> on_update) {
+    ::fand::logger()->debug("invoking serve subcommand for {0} pairs, "
+                            "trickling the data sources over {1} s",
+                            checks.size(), options->interval);
+
+    auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::seconds(options->interval));
+
+    /* every data source is evaluated again in its own slot.  the data of
+     * the other data sources is reused, whatever its age. */
+    reevaluate = true;
+    reuse_cached = true;
+
+    /* the phase is random so the nodes do not evaluate the same data
+     * source at the same time */
+    std::mt19937_64 rng(std::random_device{}());
+
+    auto next = std::chrono::steady_clock::now();
+    bool reschedule = true;
+
+    /* latest evaluation time of each data source */
+    std::map<std::string, double> trickled;
+
+    while (true) {
+      /* distinct data sources, in check pair order */
+      std::vector<std::shared_ptr<wassail::data::common>> sources;
+      std::set<std::shared_ptr<wassail::data::common>> seen;
+      for (auto const &cp : checks) {
+        if (seen.insert(cp.data).second) {
+          sources.push_back(cp.data);
+        }
+      }
+
+      auto slot = interval / std::max(sources.size(), size_t(1));
+
+      if (reschedule) {
+        std::uniform_int_distribution<int64_t> random(0, slot.count() - 1);
+        std::chrono::nanoseconds phase(random(rng));
+
+        /* the per host offset, if any, makes the phase deterministic */
+        if (options->splay > 0) {
+          phase = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      splay_offset(options->splay)) %
+                  slot.count();
+        }
+
+        next = std::chrono::steady_clock::now() + phase;
+        reschedule = false;
+
+        ::fand::logger()->info("evaluating {0} data sources every {1} s",
+                               sources.size(),
+                               std::chrono::duration<double>(slot).count());
+      }
+
+      if (sources.empty()) {
+        auto w = wait(next + interval);
+        if (w == wake_t::STOPPING) {
+          return;
+        }
+        reschedule = true;
+        continue;
+      }
+
+      for (auto const &due : sources) {
+        auto w = wait(next);
+        if (w == wake_t::STOPPING) {
+          return;
+        }
+        else if (w == wake_t::RELOADED) {
+          /* the data sources changed, start a new cycle */
+          reschedule = true;
+          trickled.clear();
+          break;
+        }
+
+        next += slot;
+        auto start = std::chrono::steady_clock::now();
+
+        /* the checks are performed again on the latest data of each
+         * data source.  data sources without data yet are skipped until
+         * their slot, so the checks that require their check pairs are
+         * skipped too. */
+        trickle_source = due;
+        auto results = perform(checks, nullptr);
+        trickle_source = nullptr;
+
+        /* the durations of the data sources evaluated in earlier slots
+         * are carried forward */
+        for (auto const &d : durations) {
+          trickled[d.first] = d.second;
+        }
+
+        publish(results, trickled, on_update);
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        ::fand::logger()->info("data source {0} checked in {1} s",
+                               due->name(), elapsed.count());
+
+        save_costs(options->state_file);
+      }
+    }
+  }
+
+  fand::wake_t fand::wait(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(serve_mutex);
+
+    while (true) {
+      serve_cv.wait_until(lock, deadline, [this]() {
+        return stopping or reload_requested;
+      });
+
+      if (stopping) {
+        return wake_t::STOPPING;
+      }
+      else if (not reload_requested) {
+        return wake_t::DEADLINE;
+      }
+
+      /* an invalid configuration keeps the previous check pairs and the
+       * schedule */
+      reload_requested = false;
+      lock.unlock();
+      bool reloaded = reload_check_pairs();
+      lock.lock();
+
+      if (reloaded) {
+        return wake_t::RELOADED;
       }
     }
   }
 
-  void fand::make_check_pairs(std::shared_ptr<options_t> options,
+  void fand::make_check_pairs(std::shared_ptr<options_t> o,
                               std::shared_ptr<wassail::result> r) {
-    auto cps = system_dispatch_table[_system](options);
-    for (const auto &cp : cps) {
-      add_check_pair(cp, r);
+    options = o;
+    overall = r;
+
+    std::vector<check_pair> cps;
+    try {
+      cps = system_dispatch_table[_system](options);
+    }
+    catch (std::exception &e) {
+      ::fand::logger()->error("error creating the checks: '{}'", e.what());
+      exit(1);
+    }
+
+    set_check_pairs(cps);
+  }
+
+  void fand::set_check_pairs(std::vector<check_pair> cps) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    /* keep the cached data of the data sources that are retained */
+    std::map<std::shared_ptr<wassail::data::common>, cache_entry> previous;
+    previous.swap(cache);
+    checks.clear();
+
+    for (auto &cp : cps) {
+      /* heavyweight data sources, e.g., benchmarks, perturb the
+       * applications running alongside */
+      if (options->low_impact and
+          (cp.resource == resource_class::EXCLUSIVE or
+           cp.resource == resource_class::MEMORY_BANDWIDTH)) {
+        ::fand::logger()->warn("not performing check {0}, data source {1} "
+                               "is too heavyweight for low impact mode",
+                               cp.id, cp.data->name());
+        continue;
+      }
+
+      /* use the global timeout unless the check pair overrides it */
+      if (cp.timeout.count() == 0) {
+        cp.timeout = std::chrono::milliseconds(options->timeout);
+      }
+
+      /* if the check pairs sharing a data source specify different
+       * TTLs, use the shortest one.  like the timeout, a TTL of 0 is
+       * unset, so it does not override the TTL of another check pair. */
+      auto e = cache.find(cp.data);
+      if (e == cache.end()) {
+        auto p = previous.find(cp.data);
+        if (p != previous.end()) {
+          cache[cp.data] = p->second;
+        }
+        cache[cp.data].ttl = cp.ttl;
+      }
+      else if (e->second.ttl.count() == 0) {
+        e->second.ttl = cp.ttl;
+      }
+      else if (cp.ttl.count() > 0) {
+        e->second.ttl = std::min(e->second.ttl, cp.ttl);
+      }
+
+      add_check_pair(cp, overall);
     }
   }
 
@@ -15,12 +15,22 @@
 
 #pragma once
 
+#include "cost_model.hpp"
+#include "data_format.hpp"
 #include "systems.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 #include <wassail/wassail.hpp>
 
 namespace fand {
@@ -29,6 +39,21 @@ namespace fand {
    */
   enum class category { CPU, FILESYSTEM, MEMORY, NETWORK, PERFORMANCE };
 
+  /*! \brief Resource classes of data sources.  The executor never runs
+   *  an EXCLUSIVE data source concurrently with any other data source,
+   *  and never runs two IO or two MEMORY_BANDWIDTH data sources
+   *  concurrently.  CHEAP data sources are packed around the others.
+   */
+  enum class resource_class { CHEAP, IO, MEMORY_BANDWIDTH, EXCLUSIVE };
+
+  /*! \brief Which data is loaded when the precollected data contains a
+   *  data source more than once.  ERROR rejects the data.
+   */
+  enum class duplicate_policy { FIRST, LAST, ERROR };
+
+  /*! \brief Default resource class of the data sources of a category */
+  resource_class default_resource(category);
+
   /*! \brief A pair of a wassail check and the wassail data source that
    *  it uses.
    */
@@ -37,25 +62,111 @@ namespace fand {
     std::shared_ptr<wassail::data::common> data;   /*!< wassail data source */
     std::shared_ptr<wassail::result>
         result; /*!< Result of the check performed on the data */
+    fand::category category; /*!< category of the check */
+    std::string id; /*!< identifier other check pairs use to require this
+                       one, defaults to the name of the check */
+    std::vector<std::string>
+        prerequisites; /*!< identifiers of the check pairs that must pass
+                          before this one is performed */
+    resource_class
+        resource; /*!< resource class of the data source, defaults to that
+                     of the category */
+    std::chrono::milliseconds timeout{
+        0}; /*!< Abandon the data source evaluation after this long, 0 is
+               the global timeout */
+    std::chrono::seconds ttl{0}; /*!< Reuse the evaluated data for this long
+                                    when checking periodically, 0 is unset.
+                                    The data of a data source without a
+                                    TTL is always reevaluated. */
+    double cost = 0; /*!< expected data source evaluation time in seconds
+                        if it has not been measured, 0 if unknown */
+    double weight = 1; /*!< relative value of the check when selecting
+                          checks to fit a budget */
 
     /*! \brief construct a check pair */
     check_pair(std::shared_ptr<wassail::check::common> c,
-               std::shared_ptr<wassail::data::common> d)
-        : check(c), data(d){};
+               std::shared_ptr<wassail::data::common> d, fand::category cat)
+        : check(c), data(d), category(cat), id(c->name()),
+          resource(default_resource(cat)){};
+  };
+
+  /*! \brief Outcome of a check performed by serve() */
+  struct check_report {
+    std::shared_ptr<wassail::result> overall; /*!< overall result */
+    std::vector<std::shared_ptr<wassail::result>>
+        results; /*!< result of each check pair, in check pair order, null
+                    if the check did not produce one */
+    std::chrono::system_clock::time_point
+        completed; /*!< time the check completed */
+    std::map<std::string, double>
+        durations; /*!< evaluation time in seconds of each data source that
+                      was evaluated, rather than cached */
+    std::map<std::string, json> data; /*!< latest data of each data source */
+    std::vector<std::string>
+        ids; /*!< identifier of each check pair, in check pair order.  The
+                check pairs change when the configuration is reloaded. */
   };
 
   struct options_t {
+    double budget = 0; /*!< wall time budget for the check in seconds, 0 is
+                          no budget */
+    std::string cache_dir =
+        FAND_STATEDIR "/cache"; /*!< path of the directory to cache the
+                                   data source evaluations, empty if not
+                                   cached */
     std::vector<fand::category> categories = {
         category::CPU, category::FILESYSTEM, category::MEMORY,
         category::NETWORK};   /*!< list of default categories */
+    bool coalesce = false; /*!< reuse the data evaluated by a concurrent
+                              invocation */
+    std::string coalesce_file =
+        FAND_RUNDIR "/data.jsonl"; /*!< path of the file used to share the
+                                      data between concurrent invocations */
+    duplicate_policy duplicates =
+        duplicate_policy::FIRST; /*!< data loaded when the precollected data
+                                    contains a data source more than once */
     std::string config_file;  /*!< path of the configuration file */
+    bool fail_fast = false;   /*!< stop at the first check with an issue */
+    wassail::result::priority_t fail_fast_priority =
+        wassail::result::priority_t::DEBUG; /*!< minimum priority of an
+                                               issue that stops the check */
+    std::string housekeeping_cpus; /*!< CPU list to pin all threads to,
+                                      empty if not pinned */
     std::string input_file;   /*!< path of the file containing the previously
                                  collected data */
+    unsigned int interval = 300; /*!< seconds between the start of
+                                    successive checks when serving */
     bool json_result = false; /*!< output the results as JSON */
+    unsigned int jobs = 0; /*!< number of worker threads, 0 is the number of
+                              online cores */
     wassail::log_level log_level = wassail::log_level::warn; /*!< log level */
+    unsigned int max_age = 0; /*!< maximum age in seconds of the cached data
+                                 to reuse, 0 does not reuse cached data */
+    bool low_impact = false; /*!< evaluate the data sources at idle priority
+                                and refuse the heavyweight ones */
+    unsigned int metrics_port = 0; /*!< localhost port to serve Prometheus
+                                      metrics on, 0 if not served */
     std::string
         output_file;       /*!< path of the file to store the collected data */
+    data_format output_format =
+        data_format::JSON; /*!< format of the collected data */
+    std::string shm_file;  /*!< path of the shared memory status page, empty
+                              if not published */
+    std::string socket_file =
+        FAND_RUNDIR "/fand.sock"; /*!< path of the socket used to query the
+                                     latest result */
+    unsigned int splay = 0; /*!< window in seconds to delay the start by a
+                               per host offset, 0 is no delay */
+    std::string state_file =
+        FAND_STATEDIR "/costs.json"; /*!< path of the file to store the
+                                        learned data source costs */
+    bool stream = false; /*!< output each check result as a JSON line as
+                            soon as the check completes */
     fand::system_t system; /*!< the system type, defines the check pairs */
+    unsigned int timeout = 0; /*!< default data source timeout in
+                                 milliseconds, 0 is no timeout */
+    bool trickle = false; /*!< evaluate one data source at a time, spread
+                             evenly across the interval, when serving */
   };
 
   /*! \brief Create the check pairs.  Specialized for each system type.
@@ -66,36 +177,262 @@ namespace fand {
 
   class fand {
   public:
-    fand(system_t, wassail::log_level = wassail::log_level::warn);
+    /*! \brief construct a fand object
+     *  \param[in] jobs Number of worker threads, 0 is the number of
+     *                  online cores
+     *  \param[in] low_impact Evaluate the data sources at idle CPU and
+     *                        I/O priority
+     *  \param[in] cpus If not empty, pin all threads to this CPU list
+     */
+    fand(system_t, wassail::log_level = wassail::log_level::warn,
+         unsigned int jobs = 0, bool low_impact = false,
+         const std::string &cpus = "");
 
     /*! \brief Add a check pair to the object */
     void add_check_pair(check_pair, std::shared_ptr<wassail::result>);
 
-    /*! \brief Perform the check */
-    void check();
+    /*! \brief Perform the check
+     *  \param[in] on_complete If not null, called as each check
+     *                         completes with its result and the time since
+     *                         the start of the check.  It may be called
+     *                         concurrently from several threads.
+     */
+    void check(std::function<void(const check_pair &,
+                                  std::shared_ptr<wassail::result>,
+                                  std::chrono::duration<double>)>
+                   on_complete = nullptr);
+
+    /*! \brief Whether any data source evaluation that was abandoned
+     *  because it timed out may still be running
+     */
+    bool has_abandoned() const;
+
+    /*! \brief The check pairs, in the order they are performed */
+    const std::list<check_pair> &check_pairs() const { return checks; }
 
     /*! \brief Collect the data
+     *  \param[in] on_data Called with the data of each distinct data
+     *                     source in JSON format as soon as it has been
+     *                     evaluated.  It may be called concurrently from
+     *                     several threads.
+     */
+    void collect(std::function<void(const json &)> on_data);
+
+    /*! \brief The data already collected, without evaluating any data
+     *  source
      *  \return list of collected data in JSON format
      */
-    std::list<json> collect();
+    std::list<json> collected() const;
 
     /*! \brief List the configured check pairs */
     void list();
 
-    /*! \brief Load precollected data from the specified stream */
+    /*! \brief Load the data cached by previous runs that is no older
+     *  than the maximum age, so only the remaining data sources are
+     *  evaluated
+     *  \param[in] dir Cache directory
+     *  \param[in] max_age Maximum age in seconds
+     */
+    void load_cache(const std::string &dir, unsigned int max_age);
+
+    /*! \brief Load the data source costs learned from previous runs */
+    void load_costs(const std::string &);
+
+    /*! \brief Load precollected data from the specified stream, in any
+     *  of the formats written by write_data()
+     *  \throws std::runtime_error if the data contains a data source more
+     *          than once and the duplicate policy is ERROR
+     */
     void load_data(std::unique_ptr<std::istream>);
 
-    /*! \brief Create the check pairs */
+    /*! \brief Load precollected data from the specified file.  Large
+     *  files are parsed in parallel.
+     *  \throws std::runtime_error if the data contains a data source more
+     *          than once and the duplicate policy is ERROR
+     */
+    void load_data(const std::string &);
+
+    /*! \brief Create the check pairs.  The options are retained for the
+     *  subsequent subcommands. */
     void make_check_pairs(std::shared_ptr<options_t>,
                           std::shared_ptr<wassail::result>);
 
+    /*! \brief Recreate the check pairs from the configuration before the
+     *  next check performed by serve(), and perform that check right away.
+     *  Safe to call from any thread.
+     */
+    void reload();
+
+    /*! \brief Cache the data of the data sources evaluated by the last
+     *  run
+     *  \param[in] dir Cache directory
+     */
+    void save_cache(const std::string &dir) const;
+
+    /*! \brief Save the learned data source costs */
+    void save_costs(const std::string &) const;
+
+    /*! \brief Perform the check repeatedly, re-evaluating the data
+     *  sources each time, until stop() is called.  When trickling, each
+     *  data source is instead evaluated in its own slot of the interval,
+     *  see trickle().
+     *  \param[in] on_update If not null, called with the report of each
+     *                       check, which replaces the previous one as the
+     *                       latest result
+     */
+    void serve(std::function<void(const check_report &)> on_update = nullptr);
+
+    /*! \brief Stop serving.  Safe to call from any thread. */
+    void stop();
+
   private:
+    /*! \brief Helper to run the executor over the check pairs, recording
+     *  the data source costs and any abandoned data sources.  If the check
+     *  function is null, only collect the data.  If the data function is
+     *  not null, it is called as each data source is evaluated. */
+    std::vector<std::shared_ptr<wassail::result>>
+        execute(const std::list<check_pair> &,
+                std::function<std::shared_ptr<wassail::result>(
+                    const check_pair &, const json &)>,
+                std::function<void(const check_pair &,
+                                   std::shared_ptr<wassail::result>,
+                                   std::chrono::duration<double>)> = nullptr,
+                std::function<void(std::shared_ptr<wassail::data::common>,
+                                   const json &)> = nullptr);
+
+    /*! \brief Helper to perform the checks
+     *  \return check results, in check pair order
+     */
+    std::vector<std::shared_ptr<wassail::result>>
+        perform(const std::list<check_pair> &,
+                std::function<void(const check_pair &,
+                                   std::shared_ptr<wassail::result>,
+                                   std::chrono::duration<double>)>);
+
+    /*! \brief Helper to load precollected data, in input order, into
+     *  the data sources with the same name
+     */
+    void load_records(const std::list<json> &);
+
+    /*! \brief Helper to build a check report from the check results
+     *  and hand it to on_update
+     *  \param[in] durations Evaluation time in seconds of the data
+     *                       sources to report
+     */
+    void publish(std::vector<std::shared_ptr<wassail::result>>,
+                 const std::map<std::string, double> &durations,
+                 std::function<void(const check_report &)> on_update);
+
+    /*! \brief Helper for serve() that evaluates one data source at a
+     *  time.  Each distinct data source has an evenly spaced slot in the
+     *  interval, offset by a random phase.  In each slot, the due data
+     *  source is evaluated and the checks are performed again on the
+     *  latest data of every data source.  The checks of the data sources
+     *  that have not been evaluated yet are skipped.  The reported
+     *  durations are those of the latest evaluation of each data source.
+     */
+    void trickle(std::function<void(const check_report &)> on_update);
+
+    /*! \brief Why wait() returned */
+    enum class wake_t { DEADLINE, RELOADED, STOPPING };
+
+    /*! \brief Helper to wait until the deadline, stop() is called, or
+     *  the check pairs are reloaded.  A reload that fails keeps waiting.
+     */
+    wake_t wait(std::chrono::steady_clock::time_point deadline);
+
+    /*! \brief Whether the cached data of a data source is still fresh */
+    bool fresh(std::shared_ptr<wassail::data::common>);
+
+    /*! \brief Helper to recreate the check pairs from the configuration.
+     *  Data sources with the same name as one of the current data sources
+     *  are replaced by the current one, so their cached data is reused.
+     *  \return false if the configuration is invalid, in which case the
+     *          current check pairs are kept
+     */
+    bool reload_check_pairs();
+
+    /*! \brief Helper to replace the check pairs and their cache entries.
+     *  The cached data of data sources that are retained is kept.
+     */
+    void set_check_pairs(std::vector<check_pair>);
+
     /*! \brief Helper to collect the data for the specified data source */
     json get_data(std::shared_ptr<wassail::data::common>);
 
     /*! \brief Populate the dispatch table for each system type */
     void make_system_dispatch_table();
 
+    /*! \brief Options used to create the check pairs */
+    std::shared_ptr<options_t> options;
+
+    /*! \brief Top level result used to create the check pairs */
+    std::shared_ptr<wassail::result> overall;
+
+    /*! \brief Re-evaluate data sources that were already collected */
+    bool reevaluate = false;
+
+    /*! \brief serve() is checking periodically, so the evaluated data is
+     *  cached */
+    bool serving = false;
+
+    /*! \brief Treat all cached data as fresh, regardless of its TTL, so
+     *  only the new data sources are evaluated after a reload, and only
+     *  the due data source is evaluated when trickling */
+    bool reuse_cached = false;
+
+    /*! \brief Data source due in the current trickle slot, the only one
+     *  that is not treated as fresh */
+    std::shared_ptr<wassail::data::common> trickle_source;
+
+    /*! \brief Most recent evaluation of a data source */
+    struct cache_entry {
+      json value; /*!< evaluated data, only kept when serving or if the
+                     data source has a TTL */
+      std::chrono::steady_clock::time_point evaluated; /*!< evaluation time */
+      std::chrono::seconds ttl{0}; /*!< how long the data remains fresh */
+      bool valid = false;          /*!< data source has been evaluated */
+    };
+
+    /*! \brief Data source cache.  Each data source has an entry,
+     *  created along with the check pairs.
+     */
+    std::map<std::shared_ptr<wassail::data::common>, cache_entry> cache;
+
+    /*! \brief Protects the cache entries */
+    mutable std::mutex cache_mutex;
+
+    /*! \brief Protects reload_requested and stopping */
+    std::mutex serve_mutex;
+
+    /*! \brief Signaled when reload() or stop() is called */
+    std::condition_variable serve_cv;
+
+    /*! \brief serve() should reload the check pairs */
+    bool reload_requested = false;
+
+    /*! \brief serve() should return */
+    bool stopping = false;
+
+    /*! \brief Learned data source costs */
+    cost_model costs;
+
+    /*! \brief Evaluation time in seconds of the data sources evaluated
+     *  by the last run */
+    std::map<std::string, double> durations;
+
+    /*! \brief Data sources abandoned because they timed out, and
+     *  whether the abandoned evaluation has since completed.  A data
+     *  source is evaluated again once its evaluation has completed.
+     */
+    std::map<std::shared_ptr<wassail::data::common>,
+             std::shared_ptr<const std::atomic<bool>>>
+        abandoned_sources;
+
+    /*! \brief Thread pool used to evaluate data sources and perform
+     *  checks */
+    std::unique_ptr<thread_pool> pool;
+
     /*! \brief List of check pairs */
     std::list<check_pair> checks;
 
@@ -0,0 +1,119 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "low_impact.hpp"
+#include "config.h"
+#include "utility.hpp"
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace fand {
+  namespace {
+    /* from linux/ioprio.h, which older kernel headers do not provide */
+    constexpr int IOPRIO_CLASS_SHIFT = 13;
+    constexpr int IOPRIO_CLASS_IDLE = 3;
+    constexpr int IOPRIO_WHO_PROCESS = 1;
+  } // namespace
+
+  void lower_thread_priority() {
+#ifdef SCHED_IDLE
+    sched_param param;
+    param.sched_priority = 0;
+    int rc = pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    if (rc != 0) {
+      ::fand::logger()->warn("unable to set the idle scheduling policy: {}",
+                             std::strerror(rc));
+    }
+#else
+    ::fand::logger()->debug("the idle scheduling policy is not available");
+#endif
+
+#ifdef SYS_ioprio_set
+    /* 0 is the calling thread */
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+      ::fand::logger()->warn("unable to set the idle I/O priority: {}",
+                             std::strerror(errno));
+    }
+#else
+    ::fand::logger()->debug("the idle I/O priority is not available");
+#endif
+  }
+
+  bool pin_threads(const std::string &cpus) {
+#ifdef HAVE_SCHED_SETAFFINITY
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    try {
+      std::stringstream ss(cpus);
+      for (std::string range; std::getline(ss, range, ',');) {
+        auto dash = range.find('-');
+        size_t pos;
+        int first = std::stoi(range.substr(0, dash), &pos);
+        if (pos != range.substr(0, dash).size()) {
+          throw std::invalid_argument(range);
+        }
+
+        int last = first;
+        if (dash != std::string::npos) {
+          last = std::stoi(range.substr(dash + 1), &pos);
+          if (pos != range.substr(dash + 1).size()) {
+            throw std::invalid_argument(range);
+          }
+        }
+
+        if (first < 0 or last < first or last >= CPU_SETSIZE) {
+          throw std::out_of_range(range);
+        }
+
+        for (int c = first; c <= last; c++) {
+          CPU_SET(c, &set);
+        }
+      }
+    }
+    catch (std::exception &e) {
+      ::fand::logger()->error("invalid CPU list '{}'", cpus);
+      return false;
+    }
+
+    if (CPU_COUNT(&set) == 0) {
+      ::fand::logger()->error("invalid CPU list '{}'", cpus);
+      return false;
+    }
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      ::fand::logger()->error("unable to pin to CPUs '{0}': {1}", cpus,
+                              std::strerror(errno));
+      return false;
+    }
+
+    ::fand::logger()->debug("pinned to CPUs {}", cpus);
+    return true;
+#else
+    ::fand::logger()->warn("CPU pinning is not available, ignoring CPU "
+                           "list '{}'",
+                           cpus);
+    return true;
+#endif
+  }
+} // namespace fand
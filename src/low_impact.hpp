@@ -0,0 +1,34 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace fand {
+  /*! \brief Lower the CPU and I/O priority of the calling thread so it
+   *  only runs on otherwise idle cores and only issues I/O when the
+   *  device is otherwise idle.  Threads created by the calling thread
+   *  inherit the priorities.  Not supported priorities are ignored.
+   */
+  void lower_thread_priority();
+
+  /*! \brief Restrict the calling thread to a set of CPUs.  Called before
+   *  any other thread is started, so every thread inherits the set.
+   *  \param[in] cpus CPU list, e.g., "0-1,4"
+   *  \return false if the CPU list is invalid or cannot be applied
+   */
+  bool pin_threads(const std::string &cpus);
+} // namespace fand
@@ -16,11 +16,25 @@
 #include "config.h"
 
 #include "CLI11/CLI11.hpp"
+#include "coalescer.hpp"
+#include "config_watcher.hpp"
+#include "data_format.hpp"
 #include "fand.hpp"
+#include "metrics_server.hpp"
+#include "ndjson.hpp"
+#include "query_server.hpp"
+#include "status_page_writer.hpp"
+#include "utility.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <pthread.h>
+#include <signal.h>
 #include <string>
+#include <thread>
 #include <vector>
 #include <wassail/wassail.hpp>
 
@@ -43,6 +57,28 @@ void cli_init(CLI::App &cli, std::shared_ptr<fand::options_t> options) {
       {"network", fand::category::NETWORK},
       {"performance", fand::category::PERFORMANCE}};
 
+  /* map string value to wassail priorities */
+  std::map<std::string, wassail::result::priority_t> priority_map{
+      {"emergency", wassail::result::priority_t::EMERGENCY},
+      {"alert", wassail::result::priority_t::ALERT},
+      {"error", wassail::result::priority_t::ERROR},
+      {"warning", wassail::result::priority_t::WARNING},
+      {"notice", wassail::result::priority_t::NOTICE},
+      {"info", wassail::result::priority_t::INFO},
+      {"debug", wassail::result::priority_t::DEBUG}};
+
+  /* map string value to collected data formats */
+  std::map<std::string, fand::data_format> format_map{
+      {"cbor", fand::data_format::CBOR},
+      {"json", fand::data_format::JSON},
+      {"msgpack", fand::data_format::MSGPACK}};
+
+  /* map string value to duplicate data policies */
+  std::map<std::string, fand::duplicate_policy> duplicate_map{
+      {"error", fand::duplicate_policy::ERROR},
+      {"first", fand::duplicate_policy::FIRST},
+      {"last", fand::duplicate_policy::LAST}};
+
   /* map string value to fand system types */
   std::map<std::string, fand::system_t> system_map{
       {"linux_custom", fand::system_t::linux_custom},
@@ -50,6 +86,9 @@ void cli_init(CLI::App &cli, std::shared_ptr<fand::options_t> options) {
 
   /* command line options appear in the help message in the order they
    * are added, so make sure they are in alphabetical order */
+  cli.add_option("--cache-dir", options->cache_dir,
+                 "Directory to cache the data source evaluations");
+
   cli.add_option("-x,--category", options->categories, "Categories")
       ->delimiter(',')
       ->transform(CLI::CheckedTransformer(category_map, CLI::ignore_case));
@@ -57,20 +96,45 @@ void cli_init(CLI::App &cli, std::shared_ptr<fand::options_t> options) {
   cli.add_option("-c,--config", options->config_file, "Configuration file")
       ->check(CLI::ExistingPath);
 
+  cli.add_option("--housekeeping-cpus", options->housekeeping_cpus,
+                 "Pin all threads to this CPU list, e.g., 0-1");
+
+  cli.add_option("--jobs", options->jobs,
+                 "Number of worker threads (default: number of online cores)")
+      ->check(CLI::NonNegativeNumber);
+
   cli.add_option("-l,--log-level", options->log_level, "Log level")
       ->transform(CLI::CheckedTransformer(log_map, CLI::ignore_case));
   //    ->transform(CLI::IsMember(log_map));
   //->default_val("warning");
 
+  cli.add_flag("--low-impact", options->low_impact,
+               "Evaluate data sources at idle CPU and I/O priority and skip "
+               "heavyweight data sources");
+
+  cli.add_option("--socket", options->socket_file,
+                 "Socket used to query the latest result when serving");
+
+  cli.add_option("--splay", options->splay,
+                 "Delay the start by a per host offset of up to this many "
+                 "seconds, derived from the hostname")
+      ->check(CLI::NonNegativeNumber);
+
+  cli.add_option("--state-file", options->state_file,
+                 "File to store the learned data source costs");
+
 #ifdef FAND_SYSTEM
   options->system = system_map[FAND_SYSTEM];
 #else
   cli.add_option("-s,--system", options->system, "System")
       ->transform(CLI::CheckedTransformer(system_map, CLI::ignore_case))
-      ->envname("FAND_SYSTEM")
-      ->required();
+      ->envname("FAND_SYSTEM");
 #endif
 
+  cli.add_option("-t,--timeout", options->timeout,
+                 "Data source timeout in milliseconds (default: no timeout)")
+      ->check(CLI::NonNegativeNumber);
+
   cli.add_flag_function("-v,--version",
                         [](size_t num) {
                           std::cout << std::string(PACKAGE_STRING) << std::endl;
@@ -84,18 +148,78 @@ void cli_init(CLI::App &cli, std::shared_ptr<fand::options_t> options) {
 
   /* collect data and check it */
   auto check_subcmd = cli.add_subcommand("check", "check subcommand");
+  check_subcmd
+      ->add_option("--budget", options->budget,
+                   "Wall time budget in seconds, skip the least valuable "
+                   "checks that do not fit")
+      ->check(CLI::NonNegativeNumber);
+  check_subcmd->add_flag("--coalesce", options->coalesce,
+                         "Reuse the data evaluated by a concurrent check "
+                         "on the same node");
+  check_subcmd->add_option("--coalesce-file", options->coalesce_file,
+                           "File used to share the data between concurrent "
+                           "checks");
+  check_subcmd
+      ->add_option("--duplicates", options->duplicates,
+                   "Data to load when the input file contains a data source "
+                   "more than once")
+      ->transform(CLI::CheckedTransformer(duplicate_map, CLI::ignore_case));
+  check_subcmd->add_flag("--fail-fast", options->fail_fast,
+                         "Stop at the first check with an issue");
+  check_subcmd
+      ->add_option("--fail-fast-priority", options->fail_fast_priority,
+                   "Minimum priority of an issue that stops the check")
+      ->transform(CLI::CheckedTransformer(priority_map, CLI::ignore_case));
   check_subcmd->add_option("-f,--file", options->input_file, "Input file")
       ->check(CLI::ExistingPath);
+  check_subcmd
+      ->add_option("--max-age", options->max_age,
+                   "Reuse the cached data no older than this many seconds "
+                   "rather than evaluating the data sources")
+      ->check(CLI::NonNegativeNumber);
   auto format = check_subcmd->add_option_group("format", "Output format type");
-  format->add_flag("-j,--json", options->json_result, "JSON output format");
+  auto json_flag =
+      format->add_flag("-j,--json", options->json_result, "JSON output format");
+  format
+      ->add_flag("--stream", options->stream,
+                 "Output each check result as a JSON line as soon as it "
+                 "completes, followed by a summary line")
+      ->excludes(json_flag);
 
   /* collect data and stop */
   auto collect_subcmd = cli.add_subcommand("collect", "collect subcommand");
   collect_subcmd->add_option("-f,--file", options->output_file, "Output file")
       ->check(CLI::NonexistentPath);
+  collect_subcmd
+      ->add_option("--format", options->output_format,
+                   "Output format, binary formats are smaller and faster "
+                   "to load")
+      ->transform(CLI::CheckedTransformer(format_map, CLI::ignore_case));
 
   /* list the checks and stop */
   auto list_subcmd = cli.add_subcommand("list", "list subcommand");
+
+  /* check periodically until interrupted */
+  auto serve_subcmd = cli.add_subcommand("serve", "serve subcommand");
+  serve_subcmd
+      ->add_option("-i,--interval", options->interval,
+                   "Seconds between the start of successive checks")
+      ->check(CLI::PositiveNumber);
+  serve_subcmd
+      ->add_option("--metrics-port", options->metrics_port,
+                   "Serve Prometheus metrics on this localhost port")
+      ->check(CLI::Range(1, 65535));
+  serve_subcmd->add_option("--shm", options->shm_file,
+                           "Publish the latest result to a shared memory "
+                           "status page, e.g., /dev/shm/fand");
+  serve_subcmd->add_flag("--trickle", options->trickle,
+                         "Evaluate one data source at a time, spread evenly "
+                         "across the interval");
+
+  /* query the latest result of a running serve subcommand */
+  auto status_subcmd = cli.add_subcommand("status", "status subcommand");
+  status_subcmd->add_flag("-j,--json", options->json_result,
+                          "Output the latest result as JSON");
 }
 
 int main(int argc, char **argv) {
@@ -112,8 +236,58 @@ int main(int argc, char **argv) {
     return cli.exit(e);
   }
 
+  if (cli.got_subcommand("status")) {
+    /* answered by the serve subcommand, so there is no need to setup
+     * anything else */
+    try {
+      auto response = fand::send_query(
+          options->socket_file,
+          options->json_result ? fand::query::JSON : fand::query::STATUS);
+
+      if (options->json_result) {
+        std::cout << response << std::endl;
+        return 0;
+      }
+
+      if (response == std::string(1, fand::query::HEALTHY)) {
+        std::cout << "OK" << std::endl;
+        return 0;
+      }
+      else if (response == std::string(1, fand::query::UNHEALTHY)) {
+        std::cout << "NOT OK" << std::endl;
+        return 1;
+      }
+      else {
+        std::cout << "UNKNOWN" << std::endl;
+        return 2;
+      }
+    }
+    catch (std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 2;
+    }
+  }
+
+#ifndef FAND_SYSTEM
+  if (cli.get_option("--system")->count() == 0) {
+    return cli.exit(CLI::RequiredError("--system"));
+  }
+#endif
+
+  /* when serving, SIGINT and SIGTERM are handled by a dedicated thread.
+   * block them before any other thread is started so that every thread
+   * inherits the mask. */
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  if (cli.got_subcommand("serve")) {
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  }
+
   /* construct fand object */
-  auto f = fand::fand(options->system, options->log_level);
+  auto f = fand::fand(options->system, options->log_level, options->jobs,
+                      options->low_impact, options->housekeeping_cpus);
 
   /* create a top level wassail result.  all the results will be children
    * of this result. */
@@ -123,23 +297,102 @@ int main(int argc, char **argv) {
   /* create check / data pairs */
   f.make_check_pairs(options, overall);
 
+  /* the data source costs learned from previous runs determine the order
+   * the data sources are evaluated */
+  f.load_costs(options->state_file);
+
+  int rc = 0;
+
+  /* spread runs started at the same time on many hosts, e.g., by cron.
+   * when serving, the offset is the phase of the periodic checks. */
+  if ((cli.got_subcommand("check") or cli.got_subcommand("collect")) and
+      options->splay > 0) {
+    auto offset = fand::splay_offset(options->splay);
+    fand::logger()->info("delaying the start by {} ms", offset.count());
+    std::this_thread::sleep_for(offset);
+  }
+
   if (cli.got_subcommand("check")) {
     /* perform system health check */
 
     if (not options->input_file.empty()) {
       /* read data from file */
-      f.load_data(
-          std::make_unique<std::ifstream>(std::ifstream{options->input_file}));
+      try {
+        f.load_data(options->input_file);
+      }
+      catch (std::exception &e) {
+        fand::logger()->error("error loading '{0}': '{1}'",
+                              options->input_file, e.what());
+        return 1;
+      }
     }
 
-    /* perform system health check */
-    f.check();
+    /* only evaluate the data sources without fresh enough cached data */
+    f.load_cache(options->cache_dir, options->max_age);
+
+    /* wait for a concurrent check on the same node.  if it published data
+     * while this one waited, reuse it rather than evaluating the data
+     * sources again. */
+    std::unique_ptr<fand::coalescer> coalescer;
+    bool coalesced = false;
+    if (options->coalesce and options->input_file.empty()) {
+      coalescer = std::make_unique<fand::coalescer>(options->coalesce_file);
+      if (coalescer->fresh()) {
+        /* coalescing is only an optimization, so evaluate the data
+         * sources if the published data cannot be loaded */
+        try {
+          f.load_data(coalescer->data());
+          coalesced = true;
+        }
+        catch (std::exception &e) {
+          fand::logger()->warn("unable to reuse the published data, "
+                               "evaluating the data sources: '{}'",
+                               e.what());
+        }
+      }
+    }
+
+    fand::data_writer writer(std::cout, fand::data_format::JSON);
+    std::atomic<size_t> completed{0};
+    auto start = std::chrono::steady_clock::now();
+
+    if (options->stream) {
+      /* write each check result as soon as it completes.  the checks
+       * complete on the worker threads, so all output goes through a
+       * single writer. */
+      f.check([&](const fand::check_pair &cp,
+                  std::shared_ptr<wassail::result> r,
+                  std::chrono::duration<double> elapsed) {
+        writer.write(fand::check_event(cp, r, elapsed));
+        completed++;
+      });
+    }
+    else {
+      f.check();
+    }
+
+    if (coalescer) {
+      /* publish the data for the checks waiting behind this one, then let
+       * them proceed */
+      if (not coalesced) {
+        coalescer->publish(f.collected());
+      }
+      coalescer.reset();
+    }
+
+    f.save_cache(options->cache_dir);
+    f.save_costs(options->state_file);
 
     /* set overall health based on check results */
     overall->priority = overall->max_priority();
     overall->issue = overall->max_issue();
 
-    if (options->json_result) {
+    if (options->stream) {
+      /* the individual results have already been written */
+      writer.write(fand::summary_event(
+          overall, completed, std::chrono::steady_clock::now() - start));
+    }
+    else if (options->json_result) {
       /* output as json */
       std::cout << static_cast<json>(overall) << std::endl;
     }
@@ -149,36 +402,79 @@ int main(int argc, char **argv) {
     }
 
     /* set exit code */
-    if (overall->issue == wassail::result::issue_t::NO) {
-      return 0;
-    }
-    else {
-      return 1;
+    if (overall->issue != wassail::result::issue_t::NO) {
+      rc = 1;
     }
   }
   else if (cli.got_subcommand("collect")) {
-    /* just collect data */
-    std::list<json> jsonl = f.collect();
-
     /* dump to standard output by default */
     auto out = std::make_unique<std::ostream>(std::cout.rdbuf());
 
     if (not options->output_file.empty()) {
       /* write to file instead */
-      out =
-          std::make_unique<std::ofstream>(std::ofstream{options->output_file});
+      out = std::make_unique<std::ofstream>(
+          std::ofstream{options->output_file, std::ios::binary});
     }
 
-    /* print out data */
-    std::for_each(jsonl.cbegin(), jsonl.cend(), [&](const json &j) {
-      (*out) << j.dump(-1, ' ', false, json::error_handler_t::replace)
-             << std::endl;
-    });
+    /* just collect data, writing the data of each data source as soon as
+     * it is ready */
+    fand::data_writer writer(*out, options->output_format);
+    f.collect([&](const json &j) { writer.write(j); });
+    f.save_cache(options->cache_dir);
+    f.save_costs(options->state_file);
   }
   else if (cli.got_subcommand("list")) {
     /* list checks */
     f.list();
   }
+  else if (cli.got_subcommand("serve")) {
+    std::thread waiter([&]() {
+      int sig;
+      sigwait(&signals, &sig);
+      fand::logger()->info("received signal {}, stopping", sig);
+      f.stop();
+    });
+
+    /* keep the check pairs resident and check periodically.  the latest
+     * result is available on the socket. */
+    fand::query_server server(options->socket_file);
+
+    std::unique_ptr<fand::status_page_writer> page;
+    if (not options->shm_file.empty()) {
+      page = std::make_unique<fand::status_page_writer>(options->shm_file,
+                                                        f.check_pairs());
+    }
+
+    std::unique_ptr<fand::metrics_server> metrics;
+    if (options->metrics_port > 0) {
+      metrics = std::make_unique<fand::metrics_server>(options->metrics_port);
+    }
+
+    /* pick up changes to the configuration without restarting */
+    std::unique_ptr<fand::config_watcher> watcher;
+    if (not options->config_file.empty()) {
+      watcher = std::make_unique<fand::config_watcher>(options->config_file,
+                                                       [&]() { f.reload(); });
+    }
+
+    f.serve([&](const fand::check_report &report) {
+      server.publish(report.overall);
+      if (page) {
+        page->publish(report);
+      }
+      if (metrics) {
+        metrics->publish(report);
+      }
+    });
+    waiter.join();
+  }
+
+  if (f.has_abandoned()) {
+    /* abandoned data source evaluations may still be running.  skip the
+     * normal process teardown so they cannot touch destroyed objects. */
+    std::cout.flush();
+    std::_Exit(rc);
+  }
 
-  return 0;
+  return rc;
 }
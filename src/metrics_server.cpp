@@ -0,0 +1,262 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "metrics_server.hpp"
+#include "socket_listener.hpp"
+#include "spdlog/fmt/fmt.h"
+#include "utility.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  namespace {
+    const std::string not_found = "HTTP/1.1 404 Not Found\r\n"
+                                  "Content-Length: 0\r\n"
+                                  "Connection: close\r\n\r\n";
+
+    const std::string unavailable = "HTTP/1.1 503 Service Unavailable\r\n"
+                                    "Content-Length: 0\r\n"
+                                    "Connection: close\r\n\r\n";
+
+    /* escape a label value */
+    std::string escape(const std::string &in) {
+      std::string out;
+      out.reserve(in.size());
+      for (auto c : in) {
+        switch (c) {
+        case '\\':
+          out += "\\\\";
+          break;
+        case '"':
+          out += "\\\"";
+          break;
+        case '\n':
+          out += "\\n";
+          break;
+        default:
+          out += c;
+        }
+      }
+      return out;
+    }
+
+    /* seconds since the epoch */
+    double seconds(std::chrono::system_clock::time_point t) {
+      return std::chrono::duration<double>(t.time_since_epoch()).count();
+    }
+
+    void header(fmt::memory_buffer &buf, const char *name, const char *help) {
+      fmt::format_to(std::back_inserter(buf),
+                     "# HELP {0} {1}\n"
+                     "# TYPE {0} gauge\n",
+                     name, help);
+    }
+
+    /* a sample for every numeric value in the data, labeled with its
+     * JSON pointer */
+    void values(fmt::memory_buffer &buf, const std::string &source,
+                const json &j, const std::string &path) {
+      if (j.is_object()) {
+        for (auto const &i : j.items()) {
+          values(buf, source, i.value(), path + "/" + i.key());
+        }
+      }
+      else if (j.is_array()) {
+        for (size_t i = 0; i < j.size(); i++) {
+          values(buf, source, j[i], path + "/" + std::to_string(i));
+        }
+      }
+      else if (j.is_number()) {
+        double v = j.get<double>();
+        if (std::isfinite(v)) {
+          fmt::format_to(std::back_inserter(buf),
+                         "fand_data_value{{source=\"{0}\",path=\"{1}\"}} "
+                         "{2}\n",
+                         escape(source), escape(path), v);
+        }
+      }
+    }
+  } // namespace
+
+  metrics_server::metrics_server(unsigned int port) {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = make_socket(AF_INET);
+    int on = 1;
+    if (fd < 0 or
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 or
+        bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 or
+        ::listen(fd, SOMAXCONN) != 0) {
+      ::fand::logger()->error("unable to listen on port {0}: {1}", port,
+                              std::strerror(errno));
+      exit(1);
+    }
+
+    /* nothing to report until the first check completes */
+    response = std::make_shared<const std::string>(unavailable);
+
+    ::fand::logger()->info("serving metrics on 127.0.0.1:{}", port);
+
+    listener = std::make_unique<socket_listener>(
+        fd, [this](int client) { answer(client); });
+  }
+
+  void metrics_server::answer(int client) {
+    /* only the request line matters, but read the whole request header so
+     * the client does not see a reset */
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos and
+           request.size() < 8192) {
+      ssize_t n = recv(client, buf, sizeof(buf), 0);
+      if (n < 0 and errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return;
+      }
+      request.append(buf, n);
+    }
+
+    if (request.compare(0, 13, "GET /metrics ") != 0) {
+      send_all(client, not_found.data(), not_found.size());
+      return;
+    }
+
+    std::shared_ptr<const std::string> r;
+    {
+      std::lock_guard<std::mutex> lock(m);
+      r = response;
+    }
+
+    send_all(client, r->data(), r->size());
+  }
+
+  void metrics_server::publish(const check_report &report) {
+    double completed = seconds(report.completed);
+    auto const &ids = report.ids;
+
+    /* several check pairs may share an identifier, e.g., one per
+     * filesystem, so each series is also labeled with the position of
+     * the check pair among those sharing its identifier */
+    std::vector<std::string> labels;
+    std::map<std::string, size_t> occurrences;
+    for (auto const &id : ids) {
+      labels.push_back(fmt::format("check=\"{0}\",pair=\"{1}\"", escape(id),
+                                   occurrences[id]++));
+    }
+
+    for (auto const &d : report.durations) {
+      durations[d.first] = d.second;
+    }
+
+    /* the capacity of the buffer is retained from the previous report */
+    buffer.clear();
+    auto out = std::back_inserter(buffer);
+
+    header(buffer, "fand_issue",
+           "Overall issue, 0 is no, 1 is maybe, 2 is yes");
+    fmt::format_to(out, "fand_issue {}\n",
+                   static_cast<int>(report.overall->issue));
+
+    header(buffer, "fand_priority", "Overall syslog priority");
+    fmt::format_to(out, "fand_priority {}\n",
+                   static_cast<int>(report.overall->priority));
+
+    header(buffer, "fand_last_check_timestamp_seconds",
+           "Time the last check completed");
+    fmt::format_to(out, "fand_last_check_timestamp_seconds {}\n", completed);
+
+    header(buffer, "fand_check_issue",
+           "Check issue, 0 is no, 1 is maybe, 2 is yes");
+    for (size_t i = 0; i < ids.size() and i < report.results.size(); i++) {
+      if (report.results[i]) {
+        fmt::format_to(out, "fand_check_issue{{{0}}} {1}\n", labels[i],
+                       static_cast<int>(report.results[i]->max_issue()));
+      }
+    }
+
+    header(buffer, "fand_check_priority", "Check syslog priority");
+    for (size_t i = 0; i < ids.size() and i < report.results.size(); i++) {
+      if (report.results[i]) {
+        fmt::format_to(out, "fand_check_priority{{{0}}} {1}\n", labels[i],
+                       static_cast<int>(report.results[i]->max_priority()));
+      }
+    }
+
+    header(buffer, "fand_check_last_success_timestamp_seconds",
+           "Time the check last completed without an issue");
+    std::map<std::string, double> success;
+    for (size_t i = 0; i < ids.size() and i < report.results.size(); i++) {
+      auto const &r = report.results[i];
+      if (r and r->max_issue() == wassail::result::issue_t::NO) {
+        success[labels[i]] = completed;
+      }
+      else if (last_success.count(labels[i]) > 0) {
+        success[labels[i]] = last_success[labels[i]];
+      }
+    }
+
+    /* forget the checks that were removed by a configuration reload */
+    last_success.swap(success);
+    for (auto const &s : last_success) {
+      fmt::format_to(out,
+                     "fand_check_last_success_timestamp_seconds{{{0}}} {1}\n",
+                     s.first, s.second);
+    }
+
+    header(buffer, "fand_data_source_duration_seconds",
+           "Most recent data source evaluation time");
+    for (auto const &d : durations) {
+      fmt::format_to(out,
+                     "fand_data_source_duration_seconds{{source=\"{0}\"}} "
+                     "{1}\n",
+                     escape(d.first), d.second);
+    }
+
+    header(buffer, "fand_data_value", "Numeric data source value");
+    for (auto const &d : report.data) {
+      values(buffer, d.first, d.second, "");
+    }
+
+    auto r = std::make_shared<std::string>(
+        fmt::format("HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: {}\r\n"
+                    "Connection: close\r\n\r\n",
+                    buffer.size()));
+    r->append(buffer.data(), buffer.size());
+
+    std::lock_guard<std::mutex> lock(m);
+    response = r;
+  }
+} // namespace fand
@@ -0,0 +1,74 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "fand.hpp"
+#include "socket_listener.hpp"
+#include "spdlog/fmt/fmt.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace fand {
+  /*! \brief Serve the latest check report as Prometheus metrics over
+   *  HTTP on localhost.
+   *
+   *  The metrics are rendered once per check report into a reusable
+   *  buffer, together with the HTTP response header, so answering a
+   *  scrape is only a matter of copying the prepared response to the
+   *  socket.
+   */
+  class metrics_server {
+  public:
+    /*! \brief Listen on 127.0.0.1
+     *  \param[in] port TCP port
+     */
+    metrics_server(unsigned int port);
+
+    metrics_server(const metrics_server &) = delete;
+    metrics_server &operator=(const metrics_server &) = delete;
+
+    /*! \brief Replace the metrics returned to scrapers.  Only one thread
+     *  may publish at a time.
+     */
+    void publish(const check_report &);
+
+  private:
+    /*! \brief Answer a single connection */
+    void answer(int);
+
+    /*! \brief Time of the last result without an issue, by check pair
+     *  labels, in seconds since the epoch */
+    std::map<std::string, double> last_success;
+
+    /*! \brief Most recent evaluation time, by data source, in seconds */
+    std::map<std::string, double> durations;
+
+    /*! \brief Buffer the metrics are rendered into */
+    fmt::memory_buffer buffer;
+
+    /*! \brief Protects response */
+    std::mutex m;
+
+    /*! \brief Prepared HTTP response */
+    std::shared_ptr<const std::string> response;
+
+    /*! \brief Accepts connections, stopped before anything else is
+     *  destroyed */
+    std::unique_ptr<socket_listener> listener;
+  };
+} // namespace fand
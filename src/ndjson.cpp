@@ -0,0 +1,91 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ndjson.hpp"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  namespace {
+    /* the names match the command line priority values */
+    std::string to_string(wassail::result::issue_t i) {
+      switch (i) {
+      case wassail::result::issue_t::NO:
+        return "no";
+      case wassail::result::issue_t::YES:
+        return "yes";
+      default:
+        return "maybe";
+      }
+    }
+
+    std::string to_string(wassail::result::priority_t p) {
+      switch (p) {
+      case wassail::result::priority_t::EMERGENCY:
+        return "emergency";
+      case wassail::result::priority_t::ALERT:
+        return "alert";
+      case wassail::result::priority_t::ERROR:
+        return "error";
+      case wassail::result::priority_t::WARNING:
+        return "warning";
+      case wassail::result::priority_t::NOTICE:
+        return "notice";
+      case wassail::result::priority_t::INFO:
+        return "info";
+      case wassail::result::priority_t::DEBUG:
+        return "debug";
+      default:
+        return "unknown";
+      }
+    }
+  } // namespace
+
+  json check_event(const check_pair &cp, std::shared_ptr<wassail::result> r,
+                   std::chrono::duration<double> elapsed) {
+    json j = {{"event", "check"},
+              {"name", cp.id},
+              {"data", cp.data->name()},
+              {"elapsed", elapsed.count()}};
+
+    if (r) {
+      j["brief"] = r->brief;
+      j["issue"] = to_string(r->max_issue());
+      j["priority"] = to_string(r->max_priority());
+
+      if (not r->detail.empty()) {
+        j["detail"] = r->detail;
+      }
+    }
+    else {
+      /* the check failed to produce a result */
+      j["issue"] = to_string(wassail::result::issue_t::MAYBE);
+      j["priority"] = nullptr;
+    }
+
+    return j;
+  }
+
+  json summary_event(std::shared_ptr<wassail::result> r, size_t checks,
+                     std::chrono::duration<double> elapsed) {
+    return {{"event", "summary"},
+            {"issue", to_string(r->issue)},
+            {"priority", to_string(r->priority)},
+            {"checks", checks},
+            {"elapsed", elapsed.count()}};
+  }
+} // namespace fand
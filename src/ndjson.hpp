@@ -0,0 +1,39 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "fand.hpp"
+#include <chrono>
+#include <memory>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  /*! \brief Event describing a completed check
+   *  \param[in] cp Check pair
+   *  \param[in] r Check result, null if the check did not produce one
+   *  \param[in] elapsed Time since the start of the run
+   */
+  json check_event(const check_pair &cp, std::shared_ptr<wassail::result> r,
+                   std::chrono::duration<double> elapsed);
+
+  /*! \brief Event summarizing the overall result of a run
+   *  \param[in] r Overall result
+   *  \param[in] checks Number of completed checks
+   *  \param[in] elapsed Wall time of the run
+   */
+  json summary_event(std::shared_ptr<wassail::result> r, size_t checks,
+                     std::chrono::duration<double> elapsed);
+} // namespace fand
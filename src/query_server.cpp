@@ -0,0 +1,198 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "query_server.hpp"
+#include "socket_listener.hpp"
+#include "utility.hpp"
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  namespace {
+    /* fill in a Unix domain socket address */
+    sockaddr_un make_address(const std::string &path) {
+      sockaddr_un addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+
+      if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("socket path '" + path + "' is too long");
+      }
+      std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+      return addr;
+    }
+  } // namespace
+
+  query_server::query_server(const std::string &p) : path(p) {
+    /* answer with an unknown status until the first result is
+     * published */
+    snapshot = std::make_shared<const snapshot_t>(
+        snapshot_t{static_cast<json>(nullptr).dump(), query::UNKNOWN});
+
+    /* checking does not depend on the socket, so keep running without
+     * it, e.g., when not permitted to create it */
+    sockaddr_un addr;
+
+    try {
+      addr = make_address(path);
+    }
+    catch (std::exception &e) {
+      ::fand::logger()->warn("{}, running without the socket", e.what());
+      return;
+    }
+
+    /* replace a socket left behind by a previous instance, but never
+     * anything else.  a socket is only stale if nothing is listening on
+     * it anymore. */
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 and S_ISSOCK(st.st_mode)) {
+      int probe = make_socket(AF_UNIX);
+      if (probe >= 0 and connect(probe, reinterpret_cast<sockaddr *>(&addr),
+                                 sizeof(addr)) == 0) {
+        ::fand::logger()->warn("another instance is listening on socket "
+                               "'{}', running without the socket",
+                               path);
+        close(probe);
+        return;
+      }
+
+      if (errno == ECONNREFUSED) {
+        unlink(path.c_str());
+      }
+
+      if (probe >= 0) {
+        close(probe);
+      }
+    }
+
+    int fd = make_socket(AF_UNIX);
+    if (fd < 0 or bind(fd, reinterpret_cast<sockaddr *>(&addr),
+                       sizeof(addr)) != 0 or
+        ::listen(fd, SOMAXCONN) != 0) {
+      ::fand::logger()->warn(
+          "unable to listen on socket '{0}': {1}, running without the socket",
+          path, std::strerror(errno));
+      if (fd >= 0) {
+        close(fd);
+      }
+      return;
+    }
+
+    ::fand::logger()->info("listening on socket {}", path);
+
+    listener = std::make_unique<socket_listener>(
+        fd, [this](int client) { answer(client); });
+  }
+
+  query_server::~query_server() {
+    /* only remove the socket if it was created */
+    if (listener) {
+      listener.reset();
+      unlink(path.c_str());
+    }
+  }
+
+  void query_server::answer(int client) {
+    char request;
+    ssize_t n;
+    do {
+      n = recv(client, &request, 1, 0);
+    } while (n < 0 and errno == EINTR);
+
+    if (n != 1) {
+      return;
+    }
+
+    std::shared_ptr<const snapshot_t> s;
+    {
+      std::lock_guard<std::mutex> lock(m);
+      s = snapshot;
+    }
+
+    switch (request) {
+    case query::JSON:
+      send_all(client, s->json.data(), s->json.size());
+      break;
+    case query::STATUS:
+      send_all(client, &s->status, 1);
+      break;
+    default:
+      ::fand::logger()->debug("ignoring unknown request '{}'", request);
+    }
+  }
+
+  void query_server::publish(std::shared_ptr<wassail::result> r) {
+    char status = query::UNKNOWN;
+    if (r->issue == wassail::result::issue_t::NO) {
+      status = query::HEALTHY;
+    }
+    else if (r->issue == wassail::result::issue_t::YES) {
+      status = query::UNHEALTHY;
+    }
+
+    /* serialize once, outside of the lock */
+    auto s = std::make_shared<const snapshot_t>(
+        snapshot_t{static_cast<json>(r).dump(
+                       -1, ' ', false, json::error_handler_t::replace),
+                   status});
+
+    std::lock_guard<std::mutex> lock(m);
+    snapshot = s;
+  }
+
+  std::string send_query(const std::string &path, char request) {
+    auto addr = make_address(path);
+
+    int fd = make_socket(AF_UNIX);
+    if (fd < 0 or
+        connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+      std::string error = std::strerror(errno);
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("unable to connect to socket '" + path +
+                               "': " + error);
+    }
+
+    send_all(fd, &request, 1);
+
+    /* the server closes the connection after the response */
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) != 0) {
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        break;
+      }
+      response.append(buf, n);
+    }
+
+    close(fd);
+    return response;
+  }
+} // namespace fand
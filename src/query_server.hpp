@@ -0,0 +1,95 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "socket_listener.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  /*! \brief Requests understood by the query server.  A request is a
+   *  single byte.
+   */
+  namespace query {
+    const char JSON = 'j';   /*!< latest result as compact JSON */
+    const char STATUS = 's'; /*!< latest verdict as a single byte */
+
+    const char HEALTHY = '0';   /*!< status: no issue */
+    const char UNHEALTHY = '1'; /*!< status: issue */
+    const char UNKNOWN = '2';   /*!< status: maybe an issue, or no result
+                                   yet */
+  } // namespace query
+
+  /*! \brief Serve the latest result on a Unix domain socket.
+   *
+   *  Each published result is serialized once, so answering a request
+   *  is only a matter of copying the prepared response to the socket.
+   *  Nothing is evaluated on behalf of a client.
+   */
+  class query_server {
+  public:
+    /*! \brief Listen on a Unix domain socket.  If the socket cannot be
+     *  created, a warning is logged and results are not served.
+     *  \param[in] path Socket path.  A stale socket is replaced, but not
+     *                  one that another instance is listening on.
+     */
+    explicit query_server(const std::string &path);
+
+    /*! \brief Stop listening and remove the socket */
+    ~query_server();
+
+    query_server(const query_server &) = delete;
+    query_server &operator=(const query_server &) = delete;
+
+    /*! \brief Replace the result returned to clients.  Safe to call from
+     *  any thread.
+     */
+    void publish(std::shared_ptr<wassail::result>);
+
+  private:
+    /*! \brief Prepared responses */
+    struct snapshot_t {
+      std::string json; /*!< compact JSON */
+      char status;      /*!< one byte status */
+    };
+
+    /*! \brief Answer a single connection */
+    void answer(int);
+
+    /*! \brief Socket path */
+    std::string path;
+
+    /*! \brief Protects snapshot */
+    std::mutex m;
+
+    /*! \brief Latest prepared responses */
+    std::shared_ptr<const snapshot_t> snapshot;
+
+    /*! \brief Accepts connections, stopped before anything else is
+     *  destroyed */
+    std::unique_ptr<socket_listener> listener;
+  };
+
+  /*! \brief Send a request to a query server
+   *  \param[in] path Socket path
+   *  \param[in] request Request byte
+   *  \return response
+   *  \throw std::runtime_error if the server could not be reached
+   */
+  std::string send_query(const std::string &path, char request);
+} // namespace fand
@@ -0,0 +1,130 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "socket_listener.hpp"
+#include "utility.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace fand {
+  namespace {
+#ifdef MSG_NOSIGNAL
+    const int send_flags = MSG_NOSIGNAL;
+#else
+    const int send_flags = 0; /* SO_NOSIGPIPE is set instead */
+#endif
+
+    void no_sigpipe(int fd) {
+#ifdef SO_NOSIGPIPE
+      int on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+  } // namespace
+
+  socket_listener::socket_listener(int f, std::function<void(int)> a)
+      : fd(f), answer(a) {
+    if (pipe(wake) != 0) {
+      ::fand::logger()->error("unable to create pipe: {}",
+                              std::strerror(errno));
+      exit(1);
+    }
+    fcntl(wake[0], F_SETFD, FD_CLOEXEC);
+    fcntl(wake[1], F_SETFD, FD_CLOEXEC);
+
+    thread = std::thread([this]() { run(); });
+  }
+
+  socket_listener::~socket_listener() {
+    /* wake up the listening thread */
+    char c = 0;
+    if (write(wake[1], &c, 1) < 0) {
+      ::fand::logger()->debug("unable to stop the listening thread");
+    }
+
+    if (thread.joinable()) {
+      thread.join();
+    }
+
+    close(fd);
+    close(wake[0]);
+    close(wake[1]);
+  }
+
+  void socket_listener::run() {
+    pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+
+    while (true) {
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ::fand::logger()->error("error waiting for connections: {}",
+                                std::strerror(errno));
+        return;
+      }
+
+      if (fds[1].revents != 0) {
+        /* stopping */
+        return;
+      }
+
+      if (fds[0].revents & POLLIN) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client >= 0) {
+          no_sigpipe(client);
+          set_timeout(client);
+          answer(client);
+          close(client);
+        }
+      }
+    }
+  }
+
+  int make_socket(int domain) {
+    int fd = socket(domain, SOCK_STREAM, 0);
+    if (fd >= 0) {
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+      no_sigpipe(fd);
+    }
+    return fd;
+  }
+
+  void send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+      ssize_t n = ::send(fd, buf, len, send_flags);
+      if (n < 0 and errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return;
+      }
+      buf += n;
+      len -= n;
+    }
+  }
+
+  void set_timeout(int fd) {
+    timeval tv = {0, 100000}; /* 100 ms */
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  }
+} // namespace fand
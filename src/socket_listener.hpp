@@ -0,0 +1,70 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+namespace fand {
+  /*! \brief Accept connections on a listening socket and answer them one
+   *  at a time on a dedicated thread.
+   */
+  class socket_listener {
+  public:
+    /*! \brief Start accepting connections
+     *  \param[in] fd Listening socket.  The listener closes it.
+     *  \param[in] answer Called with each connected socket, which is
+     *                    closed afterwards
+     */
+    socket_listener(int fd, std::function<void(int)> answer);
+
+    /*! \brief Stop accepting connections */
+    ~socket_listener();
+
+    socket_listener(const socket_listener &) = delete;
+    socket_listener &operator=(const socket_listener &) = delete;
+
+  private:
+    /*! \brief Accept connections until stopped */
+    void run();
+
+    /*! \brief Listening socket */
+    int fd;
+
+    /*! \brief Self pipe used to stop the listening thread */
+    int wake[2] = {-1, -1};
+
+    /*! \brief Function to answer a connection */
+    std::function<void(int)> answer;
+
+    /*! \brief Listening thread */
+    std::thread thread;
+  };
+
+  /*! \brief Create a stream socket that is not inherited by child
+   *  processes and does not raise SIGPIPE
+   *  \return socket, or -1 on error
+   */
+  int make_socket(int domain);
+
+  /*! \brief Write the whole buffer, unless the peer goes away */
+  void send_all(int fd, const char *buf, size_t len);
+
+  /*! \brief Limit how long a send or receive may block, so a slow client
+   *  cannot hold up the others */
+  void set_timeout(int fd);
+} // namespace fand
@@ -0,0 +1,157 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+/* Layout of the status page published by fand serve --shm, and a header
+ * only reader.  This header does not depend on the rest of fand so other
+ * tools can include it directly. */
+
+#include <atomic>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fand {
+  namespace status_page {
+    const uint32_t MAGIC = 0x444e4146; /*!< "FAND" */
+    const uint32_t VERSION = 1;        /*!< layout version */
+
+    const uint32_t MAX_CHECKS = 256; /*!< maximum number of checks */
+    const uint32_t NAME_SIZE = 64;   /*!< size of a check name, including
+                                        the terminating NUL */
+
+    /*! \brief Issue codes, same values as wassail::result::issue_t */
+    enum issue_t : int32_t { NONE = -1, NO = 0, MAYBE = 1, YES = 2 };
+
+    /*! \brief Status of a single check.  The priority uses the syslog
+     *  values of wassail::result::priority_t, or -1 if the check did not
+     *  produce a result.
+     */
+    struct check_t {
+      char name[NAME_SIZE]; /*!< check pair identifier */
+      int32_t issue;        /*!< issue code */
+      int32_t priority;     /*!< syslog priority */
+      int64_t timestamp;    /*!< time of the result, nanoseconds since the
+                               epoch */
+    };
+
+    /*! \brief Contents of the status page */
+    struct body_t {
+      int32_t issue;     /*!< overall issue code */
+      int32_t priority;  /*!< overall syslog priority */
+      int64_t timestamp; /*!< time the check completed, nanoseconds since
+                            the epoch, 0 if no check has completed yet */
+      uint32_t count;    /*!< number of valid entries in checks */
+      uint32_t reserved; /*!< padding */
+      check_t checks[MAX_CHECKS]; /*!< status of each check */
+    };
+
+    /*! \brief The status page.
+     *
+     *  The page is updated with a seqlock.  The writer increments
+     *  sequence to an odd value, updates the body, and increments
+     *  sequence to an even value.  A reader copies what it needs from the
+     *  body and retries if sequence was odd or changed meanwhile, so the
+     *  writer never waits for a reader and a reader never sees a
+     *  partially updated body.
+     */
+    struct page_t {
+      uint32_t magic;                 /*!< MAGIC */
+      uint32_t version;               /*!< VERSION */
+      std::atomic<uint64_t> sequence; /*!< seqlock sequence number */
+      body_t body;                    /*!< contents */
+    };
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+                  "the sequence must be lock free to be shared between "
+                  "processes");
+
+    /*! \brief Map a status page read only
+     *  \param[in] path Status page file, e.g., /dev/shm/fand
+     *  \return the page, or null if the file is not a status page of this
+     *  version.  Release it with unmap().
+     */
+    inline const page_t *map(const char *path) {
+      int fd = open(path, O_RDONLY);
+      if (fd < 0) {
+        return nullptr;
+      }
+
+      struct stat st;
+      if (fstat(fd, &st) != 0 or
+          static_cast<size_t>(st.st_size) < sizeof(page_t)) {
+        close(fd);
+        return nullptr;
+      }
+
+      void *p = mmap(nullptr, sizeof(page_t), PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (p == MAP_FAILED) {
+        return nullptr;
+      }
+
+      auto page = static_cast<const page_t *>(p);
+      if (page->magic != MAGIC or page->version != VERSION) {
+        munmap(p, sizeof(page_t));
+        return nullptr;
+      }
+
+      return page;
+    }
+
+    /*! \brief Release a page returned by map() */
+    inline void unmap(const page_t *page) {
+      munmap(const_cast<page_t *>(page), sizeof(page_t));
+    }
+
+    /*! \brief Read a consistent snapshot of the status page
+     *  \param[in] page Status page
+     *  \param[in] f Function that copies what it needs out of the body
+     *               and returns it.  It may be called more than once and
+     *               must not act on the values it reads.
+     *  \return the value returned by the last call of f
+     */
+    template <typename F>
+    auto read(const page_t *page, F f) -> decltype(f(page->body)) {
+      while (true) {
+        uint64_t before = page->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+          /* update in progress */
+          continue;
+        }
+
+        auto value = f(page->body);
+
+        /* the body must be read before the sequence is checked again */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (page->sequence.load(std::memory_order_relaxed) == before) {
+          return value;
+        }
+      }
+    }
+
+    /*! \brief Read the overall issue code
+     *  \return issue code, NONE if no check has completed yet
+     */
+    inline int32_t issue(const page_t *page) {
+      return read(page, [](const body_t &b) {
+        return b.timestamp == 0 ? static_cast<int32_t>(NONE) : b.issue;
+      });
+    }
+  } // namespace status_page
+} // namespace fand
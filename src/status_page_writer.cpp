@@ -0,0 +1,141 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "status_page_writer.hpp"
+#include "status_page.hpp"
+#include "utility.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <list>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wassail/wassail.hpp>
+
+namespace fand {
+  namespace {
+    /* nanoseconds since the epoch */
+    int64_t nanoseconds(std::chrono::system_clock::time_point t) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 t.time_since_epoch())
+          .count();
+    }
+  } // namespace
+
+  status_page_writer::status_page_writer(const std::string &p,
+                                         const std::list<check_pair> &pairs)
+      : path(p) {
+    /* replace the file rather than truncating it in place, so a reader
+     * that still has the previous page mapped is not affected */
+    unlink(path.c_str());
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 or ftruncate(fd, sizeof(status_page::page_t)) != 0) {
+      ::fand::logger()->error("unable to create status page '{0}': {1}", path,
+                              std::strerror(errno));
+      exit(1);
+    }
+
+    void *addr = mmap(nullptr, sizeof(status_page::page_t),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      ::fand::logger()->error("unable to map status page '{0}': {1}", path,
+                              std::strerror(errno));
+      exit(1);
+    }
+
+    /* the file is zero filled, so the sequence starts at 0 */
+    page = new (addr) status_page::page_t;
+    page->version = status_page::VERSION;
+    page->body.issue = status_page::NONE;
+    page->body.priority = -1;
+    page->body.count = std::min(static_cast<uint32_t>(pairs.size()),
+                                status_page::MAX_CHECKS);
+
+    if (pairs.size() > status_page::MAX_CHECKS) {
+      ::fand::logger()->warn("only the first {0} of {1} checks are "
+                             "published to the status page",
+                             status_page::MAX_CHECKS, pairs.size());
+    }
+
+    /* the names are written again whenever the check pairs change */
+    auto cp = pairs.cbegin();
+    for (uint32_t i = 0; i < page->body.count; i++, cp++) {
+      auto &c = page->body.checks[i];
+      std::strncpy(c.name, cp->id.c_str(), sizeof(c.name) - 1);
+      c.issue = status_page::NONE;
+      c.priority = -1;
+    }
+
+    /* readers reject the page until the magic number is set */
+    std::atomic_thread_fence(std::memory_order_release);
+    page->magic = status_page::MAGIC;
+
+    ::fand::logger()->info("publishing status page {}", path);
+  }
+
+  status_page_writer::~status_page_writer() {
+    munmap(page, sizeof(status_page::page_t));
+    unlink(path.c_str());
+  }
+
+  void status_page_writer::publish(const check_report &report) {
+    auto seq = page->sequence.load(std::memory_order_relaxed);
+
+    /* odd while the body is being updated */
+    page->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto &body = page->body;
+    body.issue = static_cast<int32_t>(report.overall->issue);
+    body.priority = static_cast<int32_t>(report.overall->priority);
+    body.timestamp = nanoseconds(report.completed);
+
+    /* the check pairs change when the configuration is reloaded */
+    body.count = std::min(static_cast<uint32_t>(report.ids.size()),
+                          status_page::MAX_CHECKS);
+    for (uint32_t i = 0; i < body.count; i++) {
+      auto &c = body.checks[i];
+      if (report.ids[i] != c.name) {
+        std::memset(c.name, 0, sizeof(c.name));
+        std::strncpy(c.name, report.ids[i].c_str(), sizeof(c.name) - 1);
+      }
+    }
+
+    for (uint32_t i = 0; i < body.count and i < report.results.size(); i++) {
+      auto const &r = report.results[i];
+      auto &c = body.checks[i];
+
+      if (r) {
+        c.issue = static_cast<int32_t>(r->max_issue());
+        c.priority = static_cast<int32_t>(r->max_priority());
+        c.timestamp = nanoseconds(r->timestamp);
+      }
+      else {
+        c.issue = status_page::NONE;
+        c.priority = -1;
+        c.timestamp = body.timestamp;
+      }
+    }
+
+    page->sequence.store(seq + 2, std::memory_order_release);
+  }
+} // namespace fand
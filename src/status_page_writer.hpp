@@ -0,0 +1,58 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "fand.hpp"
+#include "status_page.hpp"
+#include <list>
+#include <string>
+
+namespace fand {
+  /*! \brief Publish check reports to a shared memory status page.
+   *
+   *  The page is a fixed size file, typically under /dev/shm, mapped
+   *  into memory.  Readers map the same file and use the header only
+   *  reader in status_page.hpp, so reading the node health does not
+   *  require a system call.
+   */
+  class status_page_writer {
+  public:
+    /*! \brief Create the status page
+     *  \param[in] path Status page file.  An existing file is replaced.
+     *  \param[in] pairs Check pairs, in the order they are reported
+     */
+    status_page_writer(const std::string &path,
+                       const std::list<check_pair> &pairs);
+
+    /*! \brief Unmap and remove the status page */
+    ~status_page_writer();
+
+    status_page_writer(const status_page_writer &) = delete;
+    status_page_writer &operator=(const status_page_writer &) = delete;
+
+    /*! \brief Update the status page.  Only one thread may publish at a
+     *  time.
+     */
+    void publish(const check_report &);
+
+  private:
+    /*! \brief Status page file */
+    std::string path;
+
+    /*! \brief Mapped status page */
+    status_page::page_t *page = nullptr;
+  };
+} // namespace fand
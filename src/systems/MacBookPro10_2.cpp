@@ -19,21 +19,27 @@ namespace fand {
     auto sysconf = std::make_shared<wassail::data::sysconf>();
 
     if (contains(options->categories, category::CPU)) {
-      checks.emplace_back(check_pair(
-          std::make_shared<wassail::check::cpu::core_count>(4), sysconf));
+      check_pair cp(std::make_shared<wassail::check::cpu::core_count>(4),
+                    sysconf, category::CPU);
+      cp.ttl = std::chrono::hours(1); /* static system configuration */
+      checks.emplace_back(cp);
     }
 
     if (contains(options->categories, category::FILESYSTEM)) {
-      checks.emplace_back(check_pair(
+      check_pair cp(
           std::make_shared<wassail::check::disk::percent_free>("/", 5),
-          getfsstat));
+          getfsstat, category::FILESYSTEM);
+      cp.ttl = std::chrono::seconds(30);
+      checks.emplace_back(cp);
     }
 
     if (contains(options->categories, category::MEMORY)) {
-      checks.emplace_back(
-          check_pair(std::make_shared<wassail::check::memory::physical_size>(
-                         8UL * 1024 * 1024 * 1024, 1UL * 1024 * 1024),
-                     sysconf));
+      check_pair cp(std::make_shared<wassail::check::memory::physical_size>(
+                        8UL * 1024 * 1024 * 1024, 1UL * 1024 * 1024),
+                    sysconf, category::MEMORY);
+      cp.id = "memory/physical_size";
+      cp.ttl = std::chrono::hours(1); /* static system configuration */
+      checks.emplace_back(cp);
     }
 
     if (contains(options->categories, category::PERFORMANCE)) {
@@ -45,7 +51,14 @@ namespace fand {
       c->add_rule([](json j) {
         return j.value(json::json_pointer("/data/triad"), 0.0) >= 12000.0;
       });
-      checks.emplace_back(check_pair(c, stream));
+      check_pair cp(c, stream, category::PERFORMANCE);
+      cp.id = "performance/stream";
+      cp.cost = 30; /* seconds, until the cost has been measured */
+      cp.ttl = std::chrono::hours(24);
+
+      /* measuring bandwidth is pointless if memory is missing */
+      cp.prerequisites = {"memory/physical_size"};
+      checks.emplace_back(cp);
     }
 
     return checks;
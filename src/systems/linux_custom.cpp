@@ -1,18 +1,66 @@
 #include "fand.hpp"
 #include "systems.hpp"
 #include "utility.hpp"
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <wassail/wassail.hpp>
 
 namespace fand {
+  namespace {
+    /* apply the optional per entry settings to the check pair */
+    void configure(check_pair &cp, const json &entry) {
+      /* identifier used by other entries to require this one */
+      cp.id = entry.value("id", cp.id);
+
+      /* identifiers of the entries that must pass before this one is
+       * performed */
+      cp.prerequisites =
+          entry.value("requires", std::vector<std::string>());
+
+      /* data source timeout, in milliseconds */
+      cp.timeout = std::chrono::milliseconds(entry.value("timeout", 0U));
+
+      /* how long the data remains fresh when checking periodically, in
+       * seconds */
+      cp.ttl = std::chrono::seconds(entry.value("ttl", 0U));
+
+      /* expected data source evaluation time, in seconds, used until the
+       * cost has been measured */
+      cp.cost = entry.value("cost", 0.0);
+
+      /* relative value of the check when selecting checks to fit a
+       * budget */
+      cp.weight = entry.value("weight", 1.0);
+
+      /* data source resource class */
+      if (entry.contains("resource")) {
+        std::map<std::string, resource_class> resource_map{
+            {"cheap", resource_class::CHEAP},
+            {"exclusive", resource_class::EXCLUSIVE},
+            {"io", resource_class::IO},
+            {"memory-bandwidth", resource_class::MEMORY_BANDWIDTH}};
+
+        auto r = resource_map.find(entry.value("resource", ""));
+        if (r == resource_map.end()) {
+          throw std::runtime_error("unknown resource class '" +
+                                   entry.value("resource", "") + "'");
+        }
+
+        cp.resource = r->second;
+      }
+    }
+  } // namespace
+
   template <>
   std::vector<check_pair> make_system_checks<system_t::linux_custom>(
       std::shared_ptr<options_t> options) {
     ::fand::logger()->debug("making check pairs for system linux custom");
 
     if (options->config_file.empty()) {
-      ::fand::logger()->error("A configuration file must be specified");
-      exit(1);
+      throw std::runtime_error("A configuration file must be specified");
     }
 
     json config = ::fand::read_config(options->config_file);
@@ -30,9 +78,12 @@ namespace fand {
 
       if (config.contains(num_cores)) {
         int parameter = config.value(num_cores, 0);
-        checks.emplace_back(check_pair(
+        check_pair cp(
             std::make_shared<wassail::check::cpu::core_count>(parameter),
-            sysconf));
+            sysconf, category::CPU);
+        configure(cp, config.value(json::json_pointer("/cpu/core_count"),
+                                   json::object()));
+        checks.emplace_back(cp);
       }
     }
 
@@ -45,10 +96,12 @@ namespace fand {
             std::string parameter1 = f.value("filesystem", "");
             float parameter2 = f.value("percent", 0.0);
 
-            checks.emplace_back(
-                check_pair(std::make_shared<wassail::check::disk::percent_free>(
-                               parameter1, parameter2),
-                           getmntent));
+            check_pair cp(
+                std::make_shared<wassail::check::disk::percent_free>(
+                    parameter1, parameter2),
+                getmntent, category::FILESYSTEM);
+            configure(cp, f);
+            checks.emplace_back(cp);
           }
         }
       }
@@ -61,10 +114,12 @@ namespace fand {
       if (config.contains(mem_size) and config.contains(tolerance)) {
         uint64_t parameter1 = config.value(mem_size, 0UL);
         uint64_t parameter2 = config.value(tolerance, 0UL);
-        checks.emplace_back(
-            check_pair(std::make_shared<wassail::check::memory::physical_size>(
-                           parameter1, parameter2),
-                       sysconf));
+        check_pair cp(std::make_shared<wassail::check::memory::physical_size>(
+                          parameter1, parameter2),
+                      sysconf, category::MEMORY);
+        configure(cp, config.value(json::json_pointer("/memory/physical_size"),
+                                   json::object()));
+        checks.emplace_back(cp);
       }
     }
 
@@ -0,0 +1,159 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_pool.hpp"
+#include "utility.hpp"
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+namespace fand {
+  namespace {
+    /* the pool and worker index of the current thread, if it is a pool
+     * worker */
+    thread_local const thread_pool *current_pool = nullptr;
+    thread_local unsigned int current_worker = 0;
+  } // namespace
+
+  thread_pool::thread_pool(unsigned int workers, std::function<void()> i)
+      : init(i) {
+    if (workers == 0) {
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      workers = n > 0 ? static_cast<unsigned int>(n) : 1;
+    }
+
+    ::fand::logger()->debug("starting thread pool with {} workers", workers);
+
+    for (unsigned int i = 0; i < workers; i++) {
+      queues.push_back(std::make_unique<queue_t>());
+    }
+
+    for (unsigned int i = 0; i < workers; i++) {
+      threads.emplace_back(&thread_pool::worker, this, i);
+    }
+  }
+
+  thread_pool::~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stop = true;
+    }
+    cv_work.notify_all();
+
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  void thread_pool::submit(std::function<void()> task) {
+    unsigned int i;
+
+    if (current_pool == this) {
+      /* keep tasks submitted by a worker local to that worker */
+      i = current_worker;
+    }
+    else {
+      i = next++ % queues.size();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(queues[i]->m);
+      queues[i]->tasks.push_back(std::move(task));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+      queued++;
+      pending++;
+    }
+    cv_work.notify_one();
+  }
+
+  void thread_pool::wait() {
+    std::unique_lock<std::mutex> lock(m);
+    cv_done.wait(lock, [this] { return pending == 0; });
+  }
+
+  bool thread_pool::take(unsigned int i, std::function<void()> &task) {
+    /* oldest task from the worker's own queue */
+    {
+      std::lock_guard<std::mutex> lock(queues[i]->m);
+      if (not queues[i]->tasks.empty()) {
+        task = std::move(queues[i]->tasks.front());
+        queues[i]->tasks.pop_front();
+        return true;
+      }
+    }
+
+    /* newest task from another worker's queue */
+    for (size_t n = 1; n < queues.size(); n++) {
+      auto &q = queues[(i + n) % queues.size()];
+      std::lock_guard<std::mutex> lock(q->m);
+      if (not q->tasks.empty()) {
+        task = std::move(q->tasks.back());
+        q->tasks.pop_back();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void thread_pool::worker(unsigned int i) {
+    current_pool = this;
+    current_worker = i;
+
+    if (init) {
+      init();
+    }
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(m);
+        cv_work.wait(lock, [this] { return stop or queued > 0; });
+
+        if (queued == 0) {
+          /* stopping and no work left */
+          return;
+        }
+
+        /* claim a task.  the count guarantees that some queue holds an
+         * unclaimed task, so the loop below terminates. */
+        queued--;
+      }
+
+      std::function<void()> task;
+      while (not take(i, task)) {
+        std::this_thread::yield();
+      }
+
+      try {
+        task();
+      }
+      catch (std::exception &e) {
+        ::fand::logger()->error("error running task: '{}'", e.what());
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(m);
+        if (--pending == 0) {
+          cv_done.notify_all();
+        }
+      }
+    }
+  }
+} // namespace fand
@@ -0,0 +1,110 @@
+/* Copyright (c) 2021 Scott McMillan <scott.andrew.mcmillan@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fand {
+  /*! \brief Bounded work-stealing thread pool.
+   *
+   *  Each worker owns a task queue.  A worker pops tasks from the front
+   *  of its own queue, so tasks run in the order they were submitted,
+   *  and when its queue is empty, steals from the back of the other
+   *  workers' queues.  Tasks submitted from a worker thread are placed
+   *  on that worker's own queue; tasks submitted from any other thread
+   *  are distributed round-robin.
+   */
+  class thread_pool {
+  public:
+    /*! \brief construct a thread pool
+     *  \param[in] workers Number of worker threads.  If 0, use the
+     *                     number of online cores.
+     *  \param[in] init If not null, called by each worker thread before
+     *                  it runs any task, e.g., to lower its priority
+     */
+    explicit thread_pool(unsigned int workers = 0,
+                         std::function<void()> init = nullptr);
+
+    ~thread_pool();
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    /*! \brief Number of worker threads */
+    unsigned int size() const { return threads.size(); }
+
+    /*! \brief Submit a task to the pool */
+    void submit(std::function<void()>);
+
+    /*! \brief Block until all submitted tasks, including tasks submitted
+     *  by other tasks, have completed.  Must not be called from a
+     *  worker thread.
+     */
+    void wait();
+
+  private:
+    /*! \brief Per worker task queue */
+    struct queue_t {
+      std::mutex m;
+      std::deque<std::function<void()>> tasks;
+    };
+
+    /*! \brief Take a task from the worker's own queue, or steal one
+     *  from another worker */
+    bool take(unsigned int, std::function<void()> &);
+
+    /*! \brief Worker thread main loop */
+    void worker(unsigned int);
+
+    /*! \brief Per worker task queues */
+    std::vector<std::unique_ptr<queue_t>> queues;
+
+    /*! \brief Called by each worker thread when it starts */
+    std::function<void()> init;
+
+    /*! \brief Worker threads */
+    std::vector<std::thread> threads;
+
+    /*! \brief Protects queued, pending, and stop */
+    std::mutex m;
+
+    /*! \brief Signaled when a task is queued or the pool is stopped */
+    std::condition_variable cv_work;
+
+    /*! \brief Signaled when all pending tasks have completed */
+    std::condition_variable cv_done;
+
+    /*! \brief Number of tasks waiting in the queues that have not been
+     *  claimed by a worker */
+    size_t queued = 0;
+
+    /*! \brief Number of tasks submitted that have not completed */
+    size_t pending = 0;
+
+    /*! \brief Set when the pool is being destroyed */
+    bool stop = false;
+
+    /*! \brief Next queue for round-robin submission */
+    std::atomic<unsigned int> next{0};
+  };
+} // namespace fand
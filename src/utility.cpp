@@ -19,7 +19,15 @@
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
 #include <wassail/wassail.hpp>
 
 namespace fand {
@@ -47,9 +55,54 @@ namespace fand {
       return config;
     }
     catch (std::exception &e) {
-      ::fand::logger()->error("error reading configuration file: '{}'",
-                              e.what());
-      exit(1);
+      throw std::runtime_error("error reading configuration file: '" +
+                               std::string(e.what()) + "'");
     }
   }
+
+  bool replace_file(const std::string &file,
+                    std::function<void(std::ostream &)> write) {
+    std::string tmp = file + "." + std::to_string(getpid()) + ".tmp";
+    {
+      std::ofstream out(tmp);
+      write(out);
+      out.close();
+
+      if (not out) {
+        std::remove(tmp.c_str());
+        return false;
+      }
+    }
+
+    if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+      std::remove(tmp.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  std::chrono::milliseconds splay_offset(unsigned int window) {
+    if (window == 0) {
+      return std::chrono::milliseconds(0);
+    }
+
+    char hostname[256] = {0};
+    if (gethostname(hostname, sizeof(hostname) - 1) != 0) {
+      ::fand::logger()->warn("unable to get the hostname, not splaying");
+      return std::chrono::milliseconds(0);
+    }
+
+    /* FNV-1a, unlike std::hash, is the same on every host and build */
+    uint64_t h = 14695981039346656037ULL;
+    for (const char *c = hostname; *c != '\0'; c++) {
+      h ^= static_cast<unsigned char>(*c);
+      h *= 1099511628211ULL;
+    }
+
+    auto offset = std::chrono::milliseconds(h % (window * 1000ULL));
+    ::fand::logger()->debug("splay offset of {0} is {1} ms", hostname,
+                            offset.count());
+    return offset;
+  }
 } // namespace fand
@@ -16,14 +16,39 @@
 #pragma once
 
 #include "spdlog/spdlog.h"
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <ostream>
+#include <string>
 #include <vector>
 #include <wassail/wassail.hpp>
 
 namespace fand {
   std::shared_ptr<spdlog::logger> logger();
+
+  /*! \brief Read a configuration file
+   *  \throws std::runtime_error if the file cannot be read or parsed
+   */
   json read_config(const std::string);
 
+  /*! \brief Replace a file.  The contents are written to a temporary
+   *  file, unique to this process, which is then renamed over the file,
+   *  so a concurrent reader never sees a partially written file.
+   *  \param[in] file Path of the file
+   *  \param[in] write Function writing the contents
+   *  \return false if the file could not be written
+   */
+  bool replace_file(const std::string &file,
+                    std::function<void(std::ostream &)> write);
+
+  /*! \brief Deterministic per host offset within a window, derived from
+   *  a hash of the hostname, so hosts started at the same time spread
+   *  their load uniformly across the window
+   *  \param[in] window Window in seconds
+   */
+  std::chrono::milliseconds splay_offset(unsigned int window);
+
   template <typename T>
   bool contains(std::vector<T> v, T i) {
     if (std::find(v.begin(), v.end(), i) != v.end()) {